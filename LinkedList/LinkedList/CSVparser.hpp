@@ -1,11 +1,28 @@
 #ifndef     _CSVPARSER_HPP_
 # define    _CSVPARSER_HPP_
 
+# include <charconv>
+# include <cstdint>
+# include <exception>
 # include <stdexcept>
 # include <string>
+# include <type_traits>
+# include <string_view>
 # include <vector>
 # include <list>
+# include <map>
+# include <deque>
+# include <memory>
+# include <mutex>
+# include <condition_variable>
+# include <thread>
+# include <fstream>
+# include <functional>
 # include <sstream>
+# include <unordered_map>
+# include <tuple>
+# include <array>
+# include <utility>
 
 namespace csv
 {
@@ -19,82 +36,938 @@ namespace csv
         }
     };
 
+    /*
+    ** Currency amount in whole cents, e.g. "$3,000 " is 300000.
+    */
+    struct Cents
+    {
+        std::int64_t value = 0;
+
+        double toDouble(void) const
+        {
+            return static_cast<double>(value) / 100.0;
+        }
+    };
+
+    /*
+    ** Field text without surrounding blanks and enclosing quotes.
+    */
+    std::string_view trim(std::string_view);
+
+    /*
+    ** Reads an amount such as "$3,000 ", -12.5 or "$78.51 " into cents;
+    ** false if the field is not an amount or is too large to hold.
+    */
+    bool parseCurrency(std::string_view, Cents &);
+
+    /*
+    ** Orders a field for Parser::scan(): an amount or any other number
+    ** as its cents (see parseCurrency()), or a date such as 11/26/2013
+    ** or 2013-11-26 as 20131126; false if the field is neither.
+    */
+    bool parseKey(std::string_view, std::int64_t &);
+
+    template<typename T>
+    struct isNumber : std::integral_constant<bool,
+        std::is_arithmetic<T>::value && !std::is_same<T, bool>::value &&
+        !std::is_same<T, char>::value && !std::is_same<T, signed char>::value &&
+        !std::is_same<T, unsigned char>::value> {};
+
+    /*
+    ** Reads a number with std::from_chars (no locale, no allocation),
+    ** ignoring surrounding blanks and quotes. False unless the whole
+    ** field is the number; `out` may still hold a parsed prefix.
+    */
+    template<typename T>
+    bool parseNumber(std::string_view text, T &out)
+    {
+        static_assert(isNumber<T>::value, "parseNumber needs a numeric type");
+
+        text = trim(text);
+        if (!text.empty() && text.front() == '+')
+            text.remove_prefix(1);
+
+        const char *end = text.data() + text.size();
+        std::from_chars_result result = std::from_chars(text.data(), end, out);
+        return !text.empty() && result.ec == std::errc() && result.ptr == end;
+    }
+
+    /*
+    ** Read-only memory mapping of a whole file. The mapping stays valid
+    ** until close() is called or the object is destroyed.
+    */
+    class MappedFile
+    {
+        public:
+            MappedFile(void);
+            ~MappedFile(void);
+            MappedFile(const MappedFile &) = delete;
+            MappedFile &operator=(const MappedFile &) = delete;
+
+        public:
+            bool open(const std::string &);
+            void close(void);
+            bool isOpen(void) const;
+            const char *data(void) const;
+            std::size_t size(void) const;
+
+        private:
+            const char *_data;
+            std::size_t _size;
+            bool _open;
+# ifdef _WIN32
+            void *_fileHandle;
+            void *_mapHandle;
+# endif
+    };
+
+    /*
+    ** Bump allocator carving memory out of a few large blocks, which are
+    ** all released together when the arena is destroyed. Not thread
+    ** safe: each parsing thread gets its own arena.
+    */
+    class Arena
+    {
+        public:
+            Arena(std::size_t blockSize = 1 << 20);
+            ~Arena(void);
+            Arena(const Arena &) = delete;
+            Arena &operator=(const Arena &) = delete;
+
+        public:
+            void *allocate(std::size_t size, std::size_t align);
+            std::size_t blockCount(void) const;
+
+        private:
+            std::vector<std::unique_ptr<char[]> > _blocks;
+            std::size_t _blockSize;
+            char *_cursor;
+            std::size_t _left;
+    };
+
+    /*
+    ** Standard allocator over an Arena, or over the heap when it has
+    ** none. Memory from an arena is only given back with the arena.
+    */
+    template<typename T>
+    class ArenaAllocator
+    {
+        public:
+            typedef T value_type;
+
+            ArenaAllocator(Arena *arena = nullptr) noexcept
+              : _arena(arena) {}
+
+            template<typename U>
+            ArenaAllocator(const ArenaAllocator<U> &other) noexcept
+              : _arena(other.arena()) {}
+
+        public:
+            T *allocate(std::size_t n)
+            {
+                if (_arena == nullptr)
+                    return static_cast<T *>(::operator new(n * sizeof(T)));
+                return static_cast<T *>(_arena->allocate(n * sizeof(T), alignof(T)));
+            }
+
+            void deallocate(T *p, std::size_t) noexcept
+            {
+                if (_arena == nullptr)
+                    ::operator delete(p);
+            }
+
+            // copies must not outlive the parser, so they go to the heap
+            ArenaAllocator select_on_container_copy_construction(void) const
+            {
+                return ArenaAllocator();
+            }
+
+            Arena *arena(void) const noexcept
+            {
+                return _arena;
+            }
+
+            template<typename U>
+            bool operator==(const ArenaAllocator<U> &other) const noexcept
+            {
+                return _arena == other.arena();
+            }
+
+            template<typename U>
+            bool operator!=(const ArenaAllocator<U> &other) const noexcept
+            {
+                return _arena != other.arena();
+            }
+
+        private:
+            Arena *_arena;
+    };
+
+    class Parser;
+
+    /*
+    ** Column names of a file, with a hash index from name to position.
+    ** A parser builds one Header and all of its rows refer to it. A name
+    ** not found as it is is looked up again without its surrounding
+    ** blanks and quotes, so "Fund" finds a "Fund " column.
+    */
+    class Header
+    {
+    	public:
+    	    Header(void);
+    	    Header(const std::vector<std::string> &);
+    	    Header(const Header &);
+    	    Header &operator=(const Header &);
+
+    	public:
+            unsigned int size(void) const;
+            int find(const std::string &) const;
+            int find(const std::vector<std::string> &aliases) const;
+            const std::vector<std::string> &names(void) const;
+            const std::string &operator[](unsigned int) const;
+
+    	private:
+            friend class Parser;
+            friend class Row;
+            void select(const std::vector<bool> &);
+            int slot(unsigned int pos) const;
+
+    		std::vector<std::string> _names;
+    		std::unordered_map<std::string, unsigned int> _index;
+    		// where each column is in the values of a row when some are
+    		// left out (-1 for those), see Options::columns; empty when
+    		// every column is kept
+    		std::vector<int> _slots;
+    		unsigned int _kept;
+    		// parser whose rows refer to this header, told of Row::set();
+    		// a copy belongs to no parser
+    		Parser *_owner;
+    };
+
+    /*
+    ** Splits the record starting at a position into fields and returns
+    ** where it ends; one is specialized for every dialect.
+    */
+    typedef std::size_t (*Tokenizer)(std::string_view data, std::size_t pos, char sep,
+                                     std::vector<std::string_view> &fields);
+
+    /*
+    ** One record of a file. A copied row owns the values given to it
+    ** through push() and set(), but its parsed values are views into the
+    ** parser's input and it refers to the parser's Header, so those are
+    ** only valid while the parser lives.
+    */
     class Row
     {
     	public:
     	    Row(const std::vector<std::string> &);
+    	    Row(const Header &);
+    	    Row(const Row &);
+    	    Row(Row &&) noexcept;
+    	    Row &operator=(const Row &);
+    	    Row &operator=(Row &&) noexcept;
     	    ~Row(void);
 
     	public:
             unsigned int size(void) const;
             void push(const std::string &);
-            bool set(const std::string &, const std::string &); 
+            bool set(const std::string &, const std::string &);
 
     	private:
-    		const std::vector<std::string> _header;
-    		std::vector<std::string> _values;
+            friend class Parser;
+            friend class Reader;
+            friend class Writer;
+            template<typename T, typename... M> friend class Binding;
+            Row(const Header &, Arena *);
+            void clear(void);
+            void rebase(const char *from, std::size_t length, const char *to);
+            void relink(const Row &from);
+            void own(unsigned int pos, const std::string &value);
+            bool owns(unsigned int pos) const;
+            std::string_view value(unsigned int pos) const;
+
+            // what a row holds beyond its views, allocated only for a
+            // standalone row or on the first push() or set()
+            struct Owned
+            {
+                std::shared_ptr<const Header> header;
+                // one slot per position, overwritten by each new value
+                std::vector<std::string> values;
+            };
+
+            // header shared with the parser, or owned by a standalone row
+    		const Header *_header;
+            // values are views into the parser's input, or into _owned
+            // for values given through push() and set(); only those of
+            // the columns kept when the parser leaves some out
+    		std::vector<std::string_view, ArenaAllocator<std::string_view> > _values;
+    		std::unique_ptr<Owned> _owned;
+            // changed through push() or set() since the file was written
+            bool _dirty;
 
         public:
 
             template<typename T>
             const T getValue(unsigned int pos) const
             {
-                if (pos < _values.size())
+                if (pos < size())
                 {
-                    T res;
-                    std::stringstream ss;
-                    ss << _values[pos];
-                    ss >> res;
+                    T res = T();
+                    if constexpr (isNumber<T>::value)
+                        parseNumber(value(pos), res);
+                    else
+                    {
+                        std::stringstream ss;
+                        ss << value(pos);
+                        ss >> res;
+                    }
                     return res;
                 }
                 throw Error("can't return this value (doesn't exist)");
             }
+            Cents getCents(unsigned int pos) const;
             const std::string operator[](unsigned int) const;
             const std::string operator[](const std::string &valueName) const;
+            // the value itself rather than a copy, valid while the row is
+            // neither changed nor destroyed, nor its parser
+            std::string_view field(unsigned int pos) const;
+            std::string_view field(const std::string &valueName) const;
+            const Header &header(void) const;
             friend std::ostream& operator<<(std::ostream& os, const Row &row);
             friend std::ofstream& operator<<(std::ofstream& os, const Row &row);
     };
 
+    /*
+    ** One column of a columnar Parser: the values of every row stored
+    ** back to back in a single buffer, with an offsets array marking
+    ** where each value starts. A dictionary encoded column instead
+    ** stores each distinct value once and a code per row, so testing
+    ** rows for a value is comparing code() with find().
+    */
+    class Column
+    {
+    	public:
+    	    Column(void);
+    	    explicit Column(bool encoded);
+    	    Column(const Column &);
+    	    Column &operator=(const Column &);
+
+    	public:
+            unsigned int size(void) const;
+            std::string_view operator[](unsigned int row) const;
+            bool encoded(void) const;
+            // dictionary encoded columns only; find() is -1 for a value
+            // no row holds
+            unsigned int code(unsigned int row) const;
+            int find(std::string_view value) const;
+            unsigned int distinct(void) const;
+
+    	private:
+            friend class Parser;
+            void push(std::string_view);
+            void append(const Column &);
+            unsigned int intern(std::string_view);
+            void reindex(void);
+
+    		std::string _bytes;
+    		std::vector<std::size_t> _offsets;
+    		bool _encoded;
+    		std::vector<unsigned int> _codes;
+    		// distinct values by code; a deque so they never move
+    		std::deque<std::string> _values;
+    		std::unordered_map<std::string_view, unsigned int> _index;
+    };
+
+    /*
+    ** Bytes of an input file, decompressed on the fly when the file is
+    ** gzip or zstd compressed; that needs the library built in with
+    ** CSV_WITH_ZLIB or CSV_WITH_ZSTD. read() fills the whole buffer
+    ** unless the input ends first.
+    */
+    class Source
+    {
+        public:
+            static std::unique_ptr<Source> open(const std::string &);
+            static bool isCompressed(const std::string &);
+            virtual ~Source(void) {}
+            virtual std::size_t read(char *buffer, std::size_t size) = 0;
+    };
+
+    /*
+    ** Compressed files (see Source) are read as eFILE whatever their
+    ** DataType, and can be neither refreshed nor synced.
+    */
     enum DataType {
         eFILE = 0,
-        ePURE = 1
+        ePURE = 1,
+        eMAPPED = 2   // file is memory mapped, rows are views into the mapping
+    };
+
+    /*
+    ** Optional settings for Parser. The defaults parse the same way the
+    ** plain constructor always has.
+    */
+    struct Options
+    {
+        // threads tokenizing the content; 0 uses every hardware thread
+        unsigned int threads = 1;
+        // store the content as one Column per header field instead of
+        // one Row per line; rows are then built on first access. Any
+        // edit, Row::set() included, moves the table over to rows.
+        bool columnar = false;
+        // columns to keep, by position and/or header name; the others
+        // are not stored and read back empty, so such a parser can't
+        // sync(). Keeping nothing selected keeps every column.
+        std::vector<unsigned int> columns;
+        std::vector<std::string> columnNames;
+        // columns named differently from one export to another, each
+        // kept by the first of its names the header has
+        std::vector<std::vector<std::string> > columnAliases;
+        // columns to dictionary encode in columnar mode, by position
+        // and/or header name; meant for those with few distinct values
+        std::vector<unsigned int> dictionary;
+        std::vector<std::string> dictionaryNames;
+        // allocate rows from large per-parser blocks instead of one heap
+        // allocation each; they are all freed with the parser
+        bool arena = false;
+        // keep a binary copy of the parsed file next to it (<file>.snap)
+        // and load that instead while the file is unchanged
+        bool snapshot = false;
+        // read an uncompressed eFILE input on a background thread and
+        // tokenize its records as they arrive; the content is then
+        // parsed on one thread
+        bool readAhead = false;
+        // quote and escape characters, '\0' for none; an escape equal to
+        // the quote means quotes are doubled ("") inside quoted fields
+        char quote = '"';
+        char escape = '"';
+        // drop the spaces around every field
+        bool trim = false;
+        // count and time what parsing does, see Parser::stats(); timing
+        // every record costs a few percent of the parse
+        bool stats = false;
+        // set aside the records whose field count doesn't match the
+        // header, see Parser::badRecords(), instead of throwing
+        bool lenient = false;
+        // only find where each record starts, keeping that next to the
+        // file (<file>.idx) for the next parse, and tokenize a row when
+        // it is first used; not with columnar, and without threads,
+        // readAhead or snapshot
+        bool lazy = false;
+        // have sync() write the rows from the first edited one on over
+        // the file itself rather than through a temporary file; faster
+        // on large files, but a crash while syncing leaves the file
+        // half written
+        bool syncInPlace = false;
     };
 
+    /*
+    ** A record left out of the table by a lenient parser; line (from 1)
+    ** and offset are where it starts in the file.
+    */
+    struct BadRecord
+    {
+        std::uint64_t line;
+        std::uint64_t offset;
+        std::string reason;
+    };
+
+    /*
+    ** What a parser did to load its file, with Options::stats set. Times
+    ** are summed over the parsing threads.
+    */
+    struct Stats
+    {
+        std::uint64_t bytes = 0;          // input parsed
+        std::uint64_t lines = 0;          // records, blank lines included
+        std::uint64_t fields = 0;
+        std::uint64_t quotedFields = 0;
+        std::uint64_t allocations = 0;    // heap blocks taken for the table
+        std::uint64_t readNs = 0;         // reading, mapping or decompressing
+        std::uint64_t tokenizeNs = 0;     // splitting records into fields
+        std::uint64_t buildNs = 0;        // storing fields in rows or columns
+    };
+
+    /*
+    ** CSV dialect known at compile time, for parsers and readers that
+    ** are given one instead of a separator. The tokenizing loop of each
+    ** dialect has its characters as constants.
+    */
+    template<char Sep, char Quote = '"', char Escape = Quote, bool Trim = false>
+    struct Dialect
+    {
+        static_assert(Quote == '"' || Quote == '\0', "quote must be '\"' or none");
+        static_assert(Escape == Quote || Escape == '\\', "escape must be the quote or a backslash");
+
+        static constexpr char separator = Sep;
+        static constexpr char quote = Quote;
+        static constexpr char escape = Escape;
+        static constexpr bool trim = Trim;
+
+        static Options apply(Options options)
+        {
+            options.quote = Quote;
+            options.escape = Escape;
+            options.trim = Trim;
+            return options;
+        }
+    };
+
+    typedef Dialect<','> Csv;
+    typedef Dialect<'\t'> Tsv;
+    typedef Dialect<'|'> Psv;
+
     class Parser
     {
 
     public:
-        Parser(const std::string &, const DataType &type = eFILE, char sep = ',');
+        Parser(const std::string &, const DataType &type = eFILE, char sep = ',',
+               const Options &options = Options());
+        template<char Sep, char Quote, char Escape, bool Trim>
+        Parser(const std::string &data, Dialect<Sep, Quote, Escape, Trim>,
+               const DataType &type = eFILE, const Options &options = Options())
+          : Parser(data, type, Sep, Dialect<Sep, Quote, Escape, Trim>::apply(options)) {}
         ~Parser(void);
+        Parser(const Parser &) = delete;
+        Parser &operator=(const Parser &) = delete;
 
     public:
         Row &getRow(unsigned int row) const;
         unsigned int rowCount(void) const;
         unsigned int columnCount(void) const;
         std::vector<std::string> getHeader(void) const;
+        const Header &header(void) const;
         const std::string getHeaderElement(unsigned int pos) const;
         const std::string &getFileName(void) const;
+        const Column &getColumn(unsigned int pos) const;
+        bool isSelected(unsigned int pos) const;
+        Stats stats(void) const;
+        const std::vector<BadRecord> &badRecords(void) const;
+        std::vector<unsigned int> scan(unsigned int column, std::int64_t low,
+                                       std::int64_t high) const;
+        std::vector<unsigned int> scan(const std::string &column, std::int64_t low,
+                                       std::int64_t high) const;
 
     public:
         bool deleteRow(unsigned int row);
         bool addRow(unsigned int pos, const std::vector<std::string> &);
         void sync(void) const;
+        unsigned int refresh(void);
 
     protected:
     	void parseHeader(void);
+    	void selectColumns(void);
+    	void encodeColumns(void);
     	void parseContent(void);
+    	void parseStreamed(std::ifstream &);
+    	void readCompressed(void);
+    	std::size_t parseRange(std::string_view data, std::size_t begin, std::size_t end,
+    	                       std::vector<Row *> &rows, std::vector<Column> &columns,
+    	                       Arena *arena, Stats *stats,
+    	                       std::vector<BadRecord> *rejected) const;
+    	void addRecord(std::vector<std::string_view> &fields, std::vector<Row *> &rows,
+    	               std::vector<Column> &columns, Arena *arena, Stats *stats) const;
+    	void finishContent(std::size_t records);
+    	bool loadSnapshot(void);
+    	void saveSnapshot(void) const;
+    	std::string_view field(unsigned int row, unsigned int column,
+    	                       std::vector<std::string_view> *fields = nullptr) const;
+    	Row *newRow(Arena *arena) const;
+    	static void release(Row *row);
+    	std::size_t parseParallel(unsigned int threads);
+    	void materialize(void);
+    	void detach(void) const;
+    	void trackTail(std::uint64_t end) const;
+    	std::uint64_t cleanEnd(std::size_t rows) const;
+    	void makeColumns(std::vector<Column> &columns) const;
+    	void indexContent(void);
+    	void indexRange(std::string_view data, std::size_t begin, std::size_t end,
+    	                std::uint64_t base, Stats *stats, std::vector<BadRecord> *rejected);
+    	bool loadIndex(void);
+    	void saveIndex(void) const;
+    	void appendIndex(std::size_t from) const;
+    	Row *buildRow(std::size_t row) const;
+    	void updateRanges(unsigned int column) const;
+    	void startEdits(void);
+    	std::size_t locate(std::size_t row, std::size_t &offset) const;
+    	void countLive(std::size_t slot, int delta);
+    	void compact(void) const;
+    	friend class Row;
+    	void edited(const Row &row);
 
     private:
         std::string _file;
         const DataType _type;
         const char _sep;
-        std::vector<std::string> _originalFile;
-        std::vector<std::string> _header;
-        std::vector<Row *> _content;
+        const Options _options;
+        const Tokenizer _split;
+        // whole input, held either in _buffer or in _mapping; after
+        // loading a snapshot, the field bytes of the mapped snapshot
+        mutable std::string _buffer;
+        mutable MappedFile _mapping;
+        mutable std::string_view _data;
+        std::size_t _contentStart;
+        Header _header;
+        // empty when every column is kept
+        std::vector<bool> _selected;
+        // empty when no column is dictionary encoded
+        std::vector<bool> _encoded;
+        // in columnar mode entries stay null until the row is first used
+        mutable std::vector<Row *> _content;
+        std::vector<Column> _columns;
+        bool _columnsStale;
+        // one arena per parsing thread, when Options::arena is set
+        std::vector<std::unique_ptr<Arena> > _arenas;
+        // bytes of the file read so far and a hash of their last line,
+        // to tell records appended since from a rewritten file
+        mutable std::uint64_t _parsedEnd;
+        mutable std::uint64_t _tailHash;
+        // input read by refresh(), which its rows point into
+        std::list<std::string> _appended;
+        // first row added or deleted since the file was written
+        mutable std::size_t _dirtyFrom;
+        // _ends[0] is where the header ends in the file and _ends[i + 1]
+        // where row i does, for as many rows as that is known
+        mutable std::vector<std::uint64_t> _ends;
+        // _data holds the file as it is on disk
+        mutable bool _mirrorsFile;
+        bool _compressed;
+        Stats _stats;
+        // in file order; sync() drops those it writes over
+        mutable std::vector<BadRecord> _badRecords;
+        // newlines in the file before _parsedEnd, once counted
+        mutable std::uint64_t _lines;
+        // in lazy mode, where each record of the file starts; rows not
+        // built yet are tokenized from there while _lazyRows is set
+        std::vector<std::uint64_t> _starts;
+        bool _lazyRows;
+        // <file>.idx holds _starts for the file as it is
+        mutable bool _indexSaved;
+        // smallest and largest key (see parseKey()) of a column in every
+        // block of rows, for the first `rows` rows but the `dirty` blocks;
+        // worked out by scan()
+        struct Ranges
+        {
+            std::vector<std::int64_t> low;
+            std::vector<std::int64_t> high;
+            std::size_t rows = 0;
+            std::vector<std::size_t> dirty;
+        };
+        mutable std::vector<Ranges> _ranges;
+        // rows Row::set() changed since the ranges were worked out, whose
+        // blocks scan() finds once the edits are applied
+        mutable std::vector<const Row *> _edited;
+        // edits not applied to _content yet, see compact(): a deleted row
+        // is left null in _content, and added rows wait in _gaps under
+        // the position of the row they went in front of. _live is a
+        // Fenwick tree counting the rows of gap i at slot 2i and row i at
+        // slot 2i + 1, to find the row at a position; empty when no edit
+        // is pending.
+        mutable std::map<std::size_t, std::vector<Row *> > _gaps;
+        mutable std::vector<std::uint32_t> _live;
+        std::size_t _rows;  // rows while edits are pending
 
     public:
         Row &operator[](unsigned int row) const;
     };
+
+    /*
+    ** Paths of the files whose names match `pattern`, `*` and `?` being
+    ** allowed in the last component only, sorted by name; the pattern
+    ** itself when it has no wildcard. The .snap, .idx and .tmp files
+    ** kept next to CSV files never match. Throws if nothing matches.
+    */
+    std::vector<std::string> glob(const std::string &pattern);
+
+    /*
+    ** Parses several files at once, one per thread up to the number of
+    ** cores, each as Parser(file, type, sep, options) would. The parsers
+    ** come back in the order of `files`; if any file fails, an Error
+    ** naming the first one failing in that order is thrown.
+    */
+    std::vector<std::unique_ptr<Parser> > parseFiles(const std::vector<std::string> &files,
+                                                     const DataType &type = eFILE, char sep = ',',
+                                                     const Options &options = Options());
+
+    /*
+    ** A column bound to a member of T, see bind(); the first of its names
+    ** the header has is used.
+    */
+    template<typename T, typename M>
+    struct Member
+    {
+        std::vector<std::string> names;
+        M T::*member;
+    };
+
+    template<typename T, typename M>
+    Member<T, M> member(const char *name, M T::*pointer)
+    {
+        return Member<T, M>{{name}, pointer};
+    }
+
+    template<typename T, typename M>
+    Member<T, M> member(std::initializer_list<const char *> names, M T::*pointer)
+    {
+        return Member<T, M>{std::vector<std::string>(names.begin(), names.end()), pointer};
+    }
+
+    /*
+    ** Decodes rows into a struct through its members bound to column
+    ** names. resolve() looks the names up once per file, after which
+    ** decode() converts each bound field straight into its member, with
+    ** the conversion picked at compile time from the member type:
+    ** strings take the value as it is, Cents and floating point members
+    ** read amounts such as "$3,000 ", other numbers use parseNumber().
+    ** Fields that don't convert leave their member unchanged.
+    */
+    template<typename T, typename... M>
+    class Binding
+    {
+        public:
+            explicit Binding(const Member<T, M> &... members)
+              : _members(members...), _positions(), _width(0) {}
+
+        public:
+            // for Options::columnAliases, to parse only the bound columns
+            std::vector<std::vector<std::string> > names(void) const
+            {
+                return std::apply([](const Member<T, M> &... members) {
+                    return std::vector<std::vector<std::string> >{members.names...};
+                }, _members);
+            }
+
+            void resolve(const Header &header)
+            {
+                std::vector<std::vector<std::string> > bound = names();
+
+                _width = 0;
+                for (unsigned int i = 0; i != bound.size(); i++)
+                {
+                    int pos = header.find(bound[i]);
+                    if (pos < 0)
+                        throw Error(std::string("can't bind this column (doesn't exist) : ")
+                                    .append(bound[i].empty() ? std::string() : bound[i][0]));
+                    _positions[i] = static_cast<unsigned int>(pos);
+                    if (_positions[i] >= _width)
+                        _width = _positions[i] + 1;
+                }
+            }
+
+            void decode(const Row &row, T &out) const
+            {
+                if (row.size() < _width)
+                    throw Error("can't decode this row (values missing)");
+                decode(row, out, std::index_sequence_for<M...>());
+            }
+
+            T decode(const Row &row) const
+            {
+                T out;
+                decode(row, out);
+                return out;
+            }
+
+        private:
+            template<std::size_t... I>
+            void decode(const Row &row, T &out, std::index_sequence<I...>) const
+            {
+                (assign(row.value(_positions[I]), out.*(std::get<I>(_members).member)), ...);
+            }
+
+            template<typename V>
+            static void assign(std::string_view text, V &out)
+            {
+                if constexpr (std::is_same<V, std::string>::value)
+                    out.assign(text.data(), text.size());
+                else if constexpr (std::is_same<V, std::string_view>::value)
+                    out = text;
+                else if constexpr (std::is_same<V, Cents>::value)
+                    parseCurrency(text, out);
+                else if constexpr (std::is_floating_point<V>::value)
+                {
+                    V number;
+                    Cents amount;
+                    if (parseNumber(text, number))
+                        out = number;
+                    else if (parseCurrency(text, amount))
+                        out = static_cast<V>(amount.toDouble());
+                }
+                else
+                {
+                    static_assert(isNumber<V>::value, "can't bind a member of this type");
+                    V number;
+                    if (parseNumber(text, number))
+                        out = number;
+                }
+            }
+
+            std::tuple<Member<T, M>...> _members;
+            std::array<unsigned int, sizeof...(M)> _positions;
+            unsigned int _width;
+    };
+
+    template<typename T, typename... M>
+    Binding<T, M...> bind(const Member<T, M> &... members)
+    {
+        return Binding<T, M...>(members...);
+    }
+
+    /*
+    ** Forward-only cursor over a CSV file. Records are parsed one at a
+    ** time out of a fixed-size buffer, so memory use does not grow with
+    ** the file. The values of a row returned by next() are only valid
+    ** until the following call.
+    **
+    ** With read-ahead, a background thread reads the next block of the
+    ** file into a second buffer while the current one is tokenized.
+    ** Compressed files are decompressed a block at a time (see Source).
+    */
+    class Reader
+    {
+
+    public:
+        Reader(const std::string &, char sep = ',', std::size_t bufferSize = 1 << 16,
+               bool readAhead = false);
+        template<char Sep, char Quote, char Escape, bool Trim>
+        Reader(const std::string &file, Dialect<Sep, Quote, Escape, Trim>,
+               std::size_t bufferSize = 1 << 16, bool readAhead = false)
+          : Reader(file, Sep, bufferSize, readAhead, Quote, Escape, Trim) {}
+        ~Reader(void);
+        Reader(const Reader &) = delete;
+        Reader &operator=(const Reader &) = delete;
+
+    public:
+        bool next(Row &row);
+        unsigned int columnCount(void) const;
+        std::vector<std::string> getHeader(void) const;
+        const Header &header(void) const;
+        const std::string &getFileName(void) const;
+
+    public:
+        class iterator
+        {
+        public:
+            iterator(Reader *reader = nullptr);
+            const Row &operator*(void) const;
+            const Row *operator->(void) const;
+            iterator &operator++(void);
+            bool operator==(const iterator &) const;
+            bool operator!=(const iterator &) const;
+
+        private:
+            Reader *_reader;
+        };
+
+        iterator begin(void);
+        iterator end(void);
+
+    protected:
+        Reader(const std::string &, char sep, std::size_t bufferSize, bool readAhead,
+               char quote, char escape, bool trim, bool lenient = false,
+               Stats *stats = nullptr, std::vector<BadRecord> *rejected = nullptr);
+        bool fill(void);
+        void readBlocks(void);
+        void stopReading(void);
+
+    private:
+        std::string _file;
+        const char _sep;
+        const char _quote;
+        const Tokenizer _split;
+        std::unique_ptr<Source> _source;
+        std::vector<char> _buffer;
+        std::size_t _begin;
+        std::size_t _end;
+        bool _eof;
+        Header _header;
+        std::vector<std::string_view> _fields;
+        std::unique_ptr<Row> _current;  // row handed out by the iterator
+        // records of the wrong size are skipped, into _rejected if set,
+        // rather than thrown on; _stats is counted into if set
+        const bool _lenient;
+        Stats *_stats;
+        std::vector<BadRecord> *_rejected;
+        // where _buffer starts in the input, and the newlines before
+        // _begin, counted in lenient mode only
+        std::uint64_t _offset;
+        std::uint64_t _line;
+        // read-ahead block, filled by _loader while _ready is false
+        std::vector<char> _ahead;
+        std::size_t _aheadSize;
+        bool _aheadEof;
+        std::exception_ptr _aheadError;
+        bool _ready;
+        bool _stop;
+        std::mutex _lock;
+        std::condition_variable _signal;
+        std::thread _loader;
+
+        friend std::size_t parse(const std::string &, const std::function<void(const Row &)> &,
+                                 char, const Options &, Stats *, std::vector<BadRecord> *);
+    };
+
+    /*
+    ** A record as parse() hands it to its visitor; the values point into
+    ** the reader's buffer and are only valid during the call.
+    */
+    typedef const Row &RecordView;
+
+    /*
+    ** Reads `file` a record at a time and hands each record to `visitor`
+    ** as soon as it is tokenized, so no table is built; returns how many
+    ** records were visited. The header is known from every record, see
+    ** Row::header(). Follows Options::quote, escape, trim, readAhead and
+    ** lenient, setting records aside into `rejected` if given; `stats`,
+    ** if given, gets buildNs as the time spent in the visitor.
+    */
+    std::size_t parse(const std::string &file, const std::function<void(RecordView)> &visitor,
+                      char sep = ',', const Options &options = Options(),
+                      Stats *stats = nullptr, std::vector<BadRecord> *rejected = nullptr);
+
+    /*
+    ** Writes records to a CSV file a large block at a time. They go to
+    ** <file>.tmp, which replaces the file on commit(), so the file is
+    ** never seen half written; without commit() it is left untouched.
+    ** Values are written as they are: like parsed values, one holding
+    ** the separator, a quote or a newline must carry its own quotes.
+    */
+    class Writer
+    {
+
+    public:
+        Writer(const std::string &, char sep = ',', std::size_t blockSize = 1 << 20);
+        ~Writer(void);
+        Writer(const Writer &) = delete;
+        Writer &operator=(const Writer &) = delete;
+
+    public:
+        void write(const Row &);
+        void write(const std::vector<std::string> &);
+        std::uint64_t size(void) const;
+        void commit(void);
+
+    protected:
+        friend class Parser;
+        // keeps the file up to `offset` and writes on from there; in place
+        // it writes over the file and cuts it on commit(), which a crash
+        // can leave half written
+        Writer(const std::string &, char sep, std::size_t blockSize, std::uint64_t offset,
+               bool inPlace);
+        void put(std::string_view);
+        void endRecord(void);
+        void flush(void);
+
+    private:
+        std::string _file;
+        std::string _temp;  // empty when writing in place
+        const char _sep;
+        std::ofstream _stream;
+        std::string _block;
+        std::size_t _blockSize;
+        std::uint64_t _size;
+        bool _committed;
+    };
 }
 
 #endif /*!_CSVPARSER_HPP_*/
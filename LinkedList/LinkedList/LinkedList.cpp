@@ -18,9 +18,6 @@ using namespace std;
 // Global definitions visible to all methods and classes
 //============================================================================
 
-// forward declarations
-double strToDouble(string str, char ch);
-
 // define a structure to hold bid information
 struct Bid {
     string bidId; // unique identifier
@@ -295,7 +292,9 @@ Bid getBid() {
     cin.ignore();
     string strAmount;
     getline(cin, strAmount);
-    bid.amount = strToDouble(strAmount, '$');
+    csv::Cents amount;
+    csv::parseCurrency(strAmount, amount);
+    bid.amount = amount.toDouble();
 
     return bid;
 }
@@ -306,45 +305,65 @@ Bid getBid() {
  * @return a LinkedList containing all the bids read
  */
 void loadBids(string csvPath, LinkedList *list) {
-    cout << "Loading CSV file " << csvPath << endl;
+    try {
+        // a pattern such as "eBid_Monthly_Sales_*.csv" loads every monthly
+        // file it matches, in name order
+        vector<string> csvPaths = csv::glob(csvPath);
+        for (auto const& path : csvPaths) {
+            cout << "Loading CSV file " << path << endl;
+        }
 
-    // initialize the CSV Parser
-    csv::Parser file = csv::Parser(csvPath);
+        // bid fields by column name, as the monthly exports have named
+        // them, looked up once the header is read
+        auto binding = csv::bind<Bid>(
+            csv::member({ "Auction ID", "ArticleID" }, &Bid::bidId),
+            csv::member({ "Auction Title", "ArticleTitle" }, &Bid::title),
+            csv::member("Fund", &Bid::fund),
+            csv::member({ "Winning Bid", "WinningBid" }, &Bid::amount));
+
+        // initialize the CSV Parser, keeping only the
+        // columns bound above
+        csv::Options options;
+        options.columnAliases = binding.names();
+        options.stats = true;
+        options.lenient = true;
+
+        // parse the files side by side, keeping their order for the bids
+        vector<unique_ptr<csv::Parser>> files = csv::parseFiles(csvPaths, csv::eMAPPED, ',', options);
+
+        for (auto const& parsed : files) {
+            csv::Parser& file = *parsed;
+
+            // report where the load time went
+            csv::Stats stats = file.stats();
+            cout << "time: read " << stats.readNs / 1000000.0 << " ms, tokenize "
+                 << stats.tokenizeNs / 1000000.0 << " ms, build " << stats.buildNs / 1000000.0
+                 << " ms" << endl;
+
+            // report the malformed records left out instead of losing the file
+            for (auto const& bad : file.badRecords()) {
+                cerr << "line " << bad.line << " skipped: " << bad.reason << endl;
+            }
 
-    try {
-        // loop to read rows of a CSV file
-        for (int i = 0; i < file.rowCount(); i++) {
+            binding.resolve(file.header());
+
+            // loop to read rows of a CSV file
+            for (int i = 0; i < file.rowCount(); i++) {
 
-            // initialize a bid using data from current row (i)
-            Bid bid;
-            bid.bidId = file[i][1];
-            bid.title = file[i][0];
-            bid.fund = file[i][8];
-            bid.amount = strToDouble(file[i][4], '$');
+                // initialize a bid using data from current row (i)
+                Bid bid = binding.decode(file[i]);
 
-            //cout << bid.bidId << ": " << bid.title << " | " << bid.fund << " | " << bid.amount << endl;
+                //cout << bid.bidId << ": " << bid.title << " | " << bid.fund << " | " << bid.amount << endl;
 
-            // add this bid to the end
-            list->Append(bid);
+                // add this bid to the end
+                list->Append(bid);
+            }
         }
     } catch (csv::Error &e) {
         std::cerr << e.what() << std::endl;
     }
 }
 
-/**
- * Simple C function to convert a string to a double
- * after stripping out unwanted char
- *
- * credit: http://stackoverflow.com/a/24875936
- *
- * @param ch The character to strip out
- */
-double strToDouble(string str, char ch) {
-    str.erase(remove(str.begin(), str.end(), ch), str.end());
-    return atof(str.c_str());
-}
-
 /**
  * The one and only main() method
  *
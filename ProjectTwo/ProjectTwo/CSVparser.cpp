@@ -1,268 +1,3679 @@
 #include <fstream>
 #include <sstream>
 #include <iomanip>
+#include <limits>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cctype>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <numeric>
+#include <thread>
 #include "CSVparser.hpp"
 
+#ifdef _WIN32
+# ifndef WIN32_LEAN_AND_MEAN
+#  define WIN32_LEAN_AND_MEAN
+# endif
+# ifndef NOMINMAX
+#  define NOMINMAX
+# endif
+# include <windows.h>
+#else
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define CSV_USE_SSE2
+# include <emmintrin.h>
+#endif
+#ifdef _MSC_VER
+# include <intrin.h>
+#endif
+#ifdef CSV_WITH_ZLIB
+# include <zlib.h>
+#endif
+#ifdef CSV_WITH_ZSTD
+# include <zstd.h>
+#endif
+
 namespace csv {
 
-  Parser::Parser(const std::string &data, const DataType &type, char sep)
-    : _type(type), _sep(sep)
+  namespace {
+
+    /*
+    ** Index of the lowest set bit of a non-zero mask.
+    */
+    inline unsigned int lowestBit(unsigned int mask)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return static_cast<unsigned int>(index);
+#else
+        return static_cast<unsigned int>(__builtin_ctz(mask));
+#endif
+    }
+
+    /*
+    ** Bit i of the result is the parity of bits 0..i of `mask`: for a
+    ** mask of quote positions this marks every byte inside quotes.
+    */
+    inline unsigned int prefixXor(unsigned int mask)
+    {
+        mask ^= mask << 1;
+        mask ^= mask << 2;
+        mask ^= mask << 4;
+        mask ^= mask << 8;
+        return mask & 0xFFFF;
+    }
+
+    /*
+    ** Pushes the field [begin, end), without the spaces around it when
+    ** the dialect trims them.
+    */
+    template<bool Trim>
+    inline void pushField(std::string_view data, std::size_t begin, std::size_t end,
+                          std::vector<std::string_view> &fields)
+    {
+        if constexpr (Trim)
+        {
+            while (begin != end && data[begin] == ' ')
+                begin++;
+            while (end != begin && data[end - 1] == ' ')
+                end--;
+        }
+        fields.push_back(data.substr(begin, end - begin));
+    }
+
+    /*
+    ** Pushes the last field of a record ending at `i` and returns `i`.
+    */
+    template<bool Trim>
+    std::size_t endRecord(std::string_view data, std::size_t tokenStart, std::size_t i,
+                          std::vector<std::string_view> &fields)
+    {
+        std::size_t end = i;
+        if (end > tokenStart && data[end - 1] == '\r')
+            end--;
+        pushField<Trim>(data, tokenStart, end, fields);
+        return i;
+    }
+
+    /*
+    ** Splits the record starting at `pos` into `fields` and returns the
+    ** position of its line terminator, or data.size() when the record
+    ** runs to the end of `data`. Separators and newlines inside quotes
+    ** belong to the field; a trailing '\r' is dropped.
+    **
+    ** The dialect is a template argument, so each one gets a loop with
+    ** its characters as constants. A Quote of '\0' means no quoting, an
+    ** Escape other than the quote makes the next byte literal, and a
+    ** Sep of '\0' stands for any other separator, passed as `sep`.
+    **
+    ** With SSE2 the record is scanned 16 bytes at a time: quote,
+    ** separator and newline positions come out as bit masks, and the
+    ** prefix-XOR of the quote mask hides the ones inside quotes. The
+    ** scalar loop finishes whatever is left, and takes over at the
+    ** first escape byte.
+    */
+    template<char Sep, char Quote, char Escape, bool Trim>
+    std::size_t splitRecord(std::string_view data, std::size_t pos, char sep,
+                            std::vector<std::string_view> &fields)
+    {
+        const char separator = (Sep != '\0') ? Sep : sep;
+        const bool escapes = Escape != '\0' && Escape != Quote;
+        bool quoted = false;
+        std::size_t tokenStart = pos;
+        std::size_t i = pos;
+
+        fields.clear();
+#ifdef CSV_USE_SSE2
+        const __m128i quoteChar = _mm_set1_epi8(Quote);
+        const __m128i escapeChar = _mm_set1_epi8(Escape);
+        const __m128i sepChar = _mm_set1_epi8(separator);
+        const __m128i newlineChar = _mm_set1_epi8('\n');
+
+        for (; i + 16 <= data.size(); i += 16)
+        {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data.data() + i));
+            if (escapes && _mm_movemask_epi8(_mm_cmpeq_epi8(block, escapeChar)) != 0)
+                break;
+            unsigned int quotes = (Quote != '\0')
+                ? _mm_movemask_epi8(_mm_cmpeq_epi8(block, quoteChar)) : 0;
+            unsigned int newlines = _mm_movemask_epi8(_mm_cmpeq_epi8(block, newlineChar));
+            unsigned int separators = _mm_movemask_epi8(_mm_cmpeq_epi8(block, sepChar));
+            unsigned int inside = prefixXor(quotes) ^ (quoted ? 0xFFFF : 0);
+            unsigned int structural = (newlines | separators) & ~inside;
+
+            while (structural != 0)
+            {
+                std::size_t at = i + lowestBit(structural);
+
+                if (data[at] == '\n')
+                    return endRecord<Trim>(data, tokenStart, at, fields);
+                pushField<Trim>(data, tokenStart, at, fields);
+                tokenStart = at + 1;
+                structural &= structural - 1;
+            }
+            quoted = (inside & 0x8000) != 0;
+        }
+#endif
+        for (; i != data.size(); i++)
+        {
+            char c = data[i];
+
+            if (escapes && c == Escape)
+            {
+                if (i + 1 != data.size())
+                    i++;
+            }
+            else if (Quote != '\0' && c == Quote)
+                quoted = !quoted;
+            else if (!quoted && c == separator)
+            {
+                pushField<Trim>(data, tokenStart, i, fields);
+                tokenStart = i + 1;
+            }
+            else if (!quoted && c == '\n')
+                break;
+        }
+        return endRecord<Trim>(data, tokenStart, i, fields);
+    }
+
+    template<char Quote, char Escape, bool Trim>
+    Tokenizer tokenizerFor(char sep)
+    {
+        switch (sep)
+        {
+          case ',':
+            return &splitRecord<',', Quote, Escape, Trim>;
+          case '\t':
+            return &splitRecord<'\t', Quote, Escape, Trim>;
+          case ';':
+            return &splitRecord<';', Quote, Escape, Trim>;
+          case '|':
+            return &splitRecord<'|', Quote, Escape, Trim>;
+          default:
+            return &splitRecord<'\0', Quote, Escape, Trim>;
+        }
+    }
+
+    template<char Quote, char Escape>
+    Tokenizer tokenizerFor(char sep, bool trim)
+    {
+        return trim ? tokenizerFor<Quote, Escape, true>(sep)
+                    : tokenizerFor<Quote, Escape, false>(sep);
+    }
+
+    /*
+    ** The tokenizer specialized for a dialect. Common separators have a
+    ** loop of their own; the others share one.
+    */
+    Tokenizer tokenizerFor(char sep, char quote, char escape, bool trim)
+    {
+        if (quote == '"' && escape == '"')
+            return tokenizerFor<'"', '"'>(sep, trim);
+        if (quote == '"' && escape == '\\')
+            return tokenizerFor<'"', '\\'>(sep, trim);
+        if (quote == '\0' && escape == '\0')
+            return tokenizerFor<'\0', '\0'>(sep, trim);
+        if (quote == '\0' && escape == '\\')
+            return tokenizerFor<'\0', '\\'>(sep, trim);
+        throw Error("unsupported dialect (quote must be '\"' or none, escape the quote or a backslash)");
+    }
+
+    std::size_t nextRecord(std::string_view data, std::size_t end)
+    {
+        return (end == data.size()) ? end : end + 1;
+    }
+
+    bool isBlank(const std::vector<std::string_view> &fields)
+    {
+        return fields.size() == 1 && fields[0].empty();
+    }
+
+    /*
+    ** 64-bit FNV-1a, continued from `hash`.
+    */
+    std::uint64_t fnv1a(std::uint64_t hash, const void *data, std::size_t length)
+    {
+        const unsigned char *bytes = static_cast<const unsigned char *>(data);
+
+        for (std::size_t i = 0; i != length; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    const std::uint64_t FNV_OFFSET = 14695981039346656037ULL;
+
+    /*
+    ** Size and modification time of a file, false if it can't be read.
+    */
+    bool fileStamp(const std::string &path, std::uint64_t &size, std::int64_t &mtime)
+    {
+        std::error_code error;
+
+        size = std::filesystem::file_size(path, error);
+        if (error)
+            return false;
+        mtime = static_cast<std::int64_t>(
+            std::filesystem::last_write_time(path, error).time_since_epoch().count());
+        return !error;
+    }
+
+    /*
+    ** Hash of the first and last 64 KiB of a file: a cheap check that a
+    ** file of unchanged size and time still has the same content.
+    */
+    std::uint64_t sampleHash(const std::string &path, std::uint64_t size)
+    {
+        const std::uint64_t sample = 64 * 1024;
+        std::vector<char> bytes(static_cast<std::size_t>(std::min(size, sample)));
+        std::ifstream in(path.c_str(), std::ios::in | std::ios::binary);
+        std::uint64_t hash = FNV_OFFSET;
+
+        in.read(bytes.data(), bytes.size());
+        hash = fnv1a(hash, bytes.data(), static_cast<std::size_t>(in.gcount()));
+        if (size > sample)
+        {
+            in.seekg(static_cast<std::streamoff>(size - sample));
+            in.read(bytes.data(), bytes.size());
+            hash = fnv1a(hash, bytes.data(), static_cast<std::size_t>(in.gcount()));
+        }
+        return hash;
+    }
+
+    /*
+    ** Hash of a buffer taken eight bytes at a time over four lanes, so it
+    ** keeps up with reading the bytes; not meant to resist collisions
+    ** made on purpose.
+    */
+    std::uint64_t wordHash(const char *data, std::size_t length)
+    {
+        const std::uint64_t prime = 0x9E3779B97F4A7C15ULL;
+        std::uint64_t lanes[4] = { FNV_OFFSET, FNV_OFFSET ^ 1, FNV_OFFSET ^ 2, FNV_OFFSET ^ 3 };
+        std::size_t i = 0;
+
+        for (; i + 32 <= length; i += 32)
+            for (int lane = 0; lane != 4; lane++)
+            {
+                std::uint64_t word;
+                std::memcpy(&word, data + i + 8 * lane, sizeof(word));
+                lanes[lane] = (lanes[lane] ^ word) * prime;
+                lanes[lane] ^= lanes[lane] >> 29;
+            }
+        std::uint64_t hash = fnv1a(FNV_OFFSET, data + i, length - i);
+        for (int lane = 0; lane != 4; lane++)
+            hash = (hash ^ lanes[lane]) * prime;
+        return hash ^ length;
+    }
+
+    /*
+    ** wordHash() of a whole file, read a block at a time; false if it
+    ** can't be read to `size` bytes.
+    */
+    bool fileHash(const std::string &path, std::uint64_t size, std::uint64_t &hash)
+    {
+        std::ifstream in(path.c_str(), std::ios::in | std::ios::binary);
+        std::vector<char> block(static_cast<std::size_t>(std::min<std::uint64_t>(size, 1 << 20)));
+        std::uint64_t left = size;
+
+        hash = FNV_OFFSET;
+        while (left != 0 && in)
+        {
+            std::size_t count = static_cast<std::size_t>(std::min<std::uint64_t>(left, block.size()));
+            in.read(block.data(), count);
+            hash = (hash ^ wordHash(block.data(), count)) * 1099511628211ULL;
+            left -= count;
+        }
+        return left == 0 && in;
+    }
+
+    /*
+    ** Fixed part of a snapshot file. It is followed by the table, every
+    ** header name as a 32-bit length and its bytes, then the length of
+    ** every field of the columns kept, row by row, as a varint (7 bits a
+    ** byte, low bits first); and by the bytes of those fields back to
+    ** back. The hash covers the table only: the source file is checked
+    ** against fileHash, and the bytes can only be out of step with the
+    ** table if the snapshot was cut short, which its size tells.
+    */
+    struct SnapshotHeader
+    {
+        char magic[8];
+        std::uint64_t version;
+        std::uint64_t fileSize;
+        std::int64_t fileTime;
+        std::uint64_t fileHash;
+        std::uint64_t selection;
+        std::uint64_t dialect;
+        std::uint64_t columns;
+        std::uint64_t kept;
+        std::uint64_t rows;
+        std::uint64_t tableSize;
+        std::uint64_t tableHash;
+        std::uint64_t bytesSize;
+    };
+
+    const char SNAPSHOT_MAGIC[8] = { 'C', 'S', 'V', 'S', 'N', 'A', 'P', '\0' };
+    const std::uint64_t SNAPSHOT_VERSION = 3;
+
+    /*
+    ** Fixed part of an index file, followed by where each record of the
+    ** file starts, as 64-bit integers.
+    */
+    struct IndexHeader
+    {
+        char magic[8];
+        std::uint64_t version;
+        std::uint64_t fileSize;
+        std::int64_t fileTime;
+        std::uint64_t fileHash;
+        std::uint64_t dialect;
+        std::uint64_t records;
+        std::uint64_t payloadHash;
+    };
+
+    const char INDEX_MAGIC[8] = { 'C', 'S', 'V', 'I', 'N', 'D', 'E', 'X' };
+    const std::uint64_t INDEX_VERSION = 1;
+
+    // rows per block of the ranges kept for Parser::scan()
+    const std::size_t RANGE_BLOCK = 4096;
+
+    /*
+    ** Separator, quote, escape and trimming of a dialect in one word.
+    */
+    std::uint64_t dialectCode(char sep, const Options &options)
+    {
+        return static_cast<unsigned char>(sep)
+            | static_cast<std::uint64_t>(static_cast<unsigned char>(options.quote)) << 8
+            | static_cast<std::uint64_t>(static_cast<unsigned char>(options.escape)) << 16
+            | static_cast<std::uint64_t>(options.trim) << 24;
+    }
+
+    /*
+    ** Reads the (at most) 64 KiB of a file that end at byte `end`.
+    */
+    bool readTail(const std::string &path, std::uint64_t end, std::string &bytes)
+    {
+        const std::uint64_t window = 64 * 1024;
+        std::ifstream in(path.c_str(), std::ios::in | std::ios::binary);
+
+        bytes.resize(static_cast<std::size_t>(std::min(end, window)));
+        in.seekg(static_cast<std::streamoff>(end - bytes.size()));
+        in.read(&bytes[0], bytes.size());
+        return in.good() || (in.eof() && static_cast<std::size_t>(in.gcount()) == bytes.size());
+    }
+
+    /*
+    ** Hash of the last line of `bytes`, line terminator included.
+    */
+    std::uint64_t lastLineHash(std::string_view bytes)
+    {
+        std::size_t end = bytes.size();
+        if (end != 0 && bytes[end - 1] == '\n')
+            end--;
+        std::size_t start = (end == 0) ? std::string_view::npos : bytes.rfind('\n', end - 1);
+        start = (start == std::string_view::npos) ? 0 : start + 1;
+        return fnv1a(FNV_OFFSET, bytes.data() + start, bytes.size() - start);
+    }
+
+    /*
+    ** Length of the complete records at the start of `data`, which must
+    ** begin on a record: up to the last newline outside quotes. Without
+    ** escapes that is found backwards from the quote parity; escapes
+    ** need a scan from the start.
+    */
+    std::size_t completeLength(std::string_view data, char quote, char escape)
+    {
+        if (escape != '\0' && escape != quote)
+        {
+            std::size_t complete = 0;
+            bool quoted = false;
+            for (std::size_t i = 0; i < data.size(); i++)
+            {
+                if (data[i] == escape)
+                    i++;
+                else if (quote != '\0' && data[i] == quote)
+                    quoted = !quoted;
+                else if (data[i] == '\n' && !quoted)
+                    complete = i + 1;
+            }
+            return complete;
+        }
+
+        bool quoted = quote != '\0' && (std::count(data.begin(), data.end(), quote) & 1) != 0;
+        for (std::size_t i = data.size(); i != 0; i--)
+        {
+            if (data[i - 1] == '\n' && !quoted)
+                return i;
+            if (quote != '\0' && data[i - 1] == quote)
+                quoted = !quoted;
+        }
+        return 0;
+    }
+
+    /*
+    ** Reads a stream into a buffer on a background thread, one block at
+    ** a time, so what has arrived can be used while the rest is read.
+    */
+    class BlockLoader
+    {
+      public:
+        BlockLoader(std::ifstream &in, char *buffer, std::size_t size)
+          : _read(0), _done(false), _stop(false)
+        {
+            _thread = std::thread([this, &in, buffer, size]() {
+                const std::size_t block = 1 << 20;
+                std::unique_lock<std::mutex> lock(_lock);
+
+                while (!_stop && _read != size)
+                {
+                    std::size_t at = _read;
+                    lock.unlock();
+                    in.read(buffer + at, std::min(block, size - at));
+                    std::size_t count = static_cast<std::size_t>(in.gcount());
+                    lock.lock();
+                    _read += count;
+                    _signal.notify_all();
+                    if (count == 0)
+                        break;
+                }
+                _done = true;
+                _signal.notify_all();
+            });
+        }
+
+        ~BlockLoader(void)
+        {
+            {
+                std::lock_guard<std::mutex> lock(_lock);
+                _stop = true;
+            }
+            _thread.join();
+        }
+
+        /*
+        ** Waits until more than `count` bytes are read or reading is
+        ** over, and returns how many are read.
+        */
+        std::size_t waitPast(std::size_t count, bool &done)
+        {
+            std::unique_lock<std::mutex> lock(_lock);
+
+            _signal.wait(lock, [this, count]() { return _done || _read > count; });
+            done = _done;
+            return _read;
+        }
+
+      private:
+        std::size_t _read;
+        bool _done;
+        bool _stop;
+        std::mutex _lock;
+        std::condition_variable _signal;
+        std::thread _thread;
+    };
+
+    typedef std::chrono::steady_clock Clock;
+
+    std::uint64_t nanoseconds(Clock::time_point since)
+    {
+        return static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - since).count());
+    }
+
+    /*
+    ** Counts a tokenized record; quoted fields are those starting with
+    ** the quote character.
+    */
+    void countRecord(Stats &stats, const std::vector<std::string_view> &fields, char quote)
+    {
+        stats.lines++;
+        stats.fields += fields.size();
+        if (quote != '\0')
+            for (auto it = fields.begin(); it != fields.end(); it++)
+                if (!it->empty() && it->front() == quote)
+                    stats.quotedFields++;
+    }
+
+    /*
+    ** Sets the line of each record in [first, last), which are in file
+    ** order, from `data`: the file from `offset` on, starting on `line`.
+    */
+    void numberLines(std::string_view data, std::uint64_t offset, std::uint64_t line,
+                     std::vector<BadRecord>::iterator first,
+                     std::vector<BadRecord>::iterator last)
+    {
+        std::size_t pos = 0;
+
+        for (; first != last; first++)
+        {
+            std::size_t at = static_cast<std::size_t>(first->offset - offset);
+            line += std::count(data.begin() + pos, data.begin() + at, '\n');
+            pos = at;
+            first->line = line;
+        }
+    }
+
+    /*
+    ** Counts the newlines in the first `end` bytes of a file.
+    */
+    bool countLines(const std::string &path, std::uint64_t end, std::uint64_t &lines)
+    {
+        std::ifstream in(path.c_str(), std::ios::in | std::ios::binary);
+        std::vector<char> block(1 << 16);
+
+        lines = 0;
+        while (end != 0)
+        {
+            std::size_t wanted = static_cast<std::size_t>(std::min<std::uint64_t>(end, block.size()));
+            if (!in.read(block.data(), wanted))
+                return false;
+            lines += std::count(block.begin(), block.begin() + wanted, '\n');
+            end -= wanted;
+        }
+        return true;
+    }
+
+    void addStats(Stats &into, const Stats &from)
+    {
+        into.bytes += from.bytes;
+        into.lines += from.lines;
+        into.fields += from.fields;
+        into.quotedFields += from.quotedFields;
+        into.allocations += from.allocations;
+        into.readNs += from.readNs;
+        into.tokenizeNs += from.tokenizeNs;
+        into.buildNs += from.buildNs;
+    }
+  }
+
+  std::string_view trim(std::string_view text)
+  {
+      const char *blanks = " \t\r";
+
+      while (true)
+      {
+          std::size_t first = text.find_first_not_of(blanks);
+          if (first == std::string_view::npos)
+              return std::string_view();
+          text = text.substr(first, text.find_last_not_of(blanks) - first + 1);
+
+          if (text.size() < 2 || text.front() != '"' || text.back() != '"')
+              return text;
+          text = text.substr(1, text.size() - 2);
+      }
+  }
+
+  bool parseCurrency(std::string_view text, Cents &out)
+  {
+      std::int64_t cents = 0;
+      bool negative = false;
+      bool digits = false;
+      std::size_t i = 0;
+
+      text = trim(text);
+      for (; i != text.size() && (text[i] == '-' || text[i] == '$'); i++)
+          negative = negative || text[i] == '-';
+
+      // whole units, with optional thousands separators, as many as
+      // leave room for the cents
+      const std::int64_t most = (std::numeric_limits<std::int64_t>::max() - 100) / 100;
+      for (; i != text.size() && (std::isdigit(static_cast<unsigned char>(text[i])) || text[i] == ','); i++)
+      {
+          if (text[i] == ',')
+              continue;
+          if (cents > (most - (text[i] - '0')) / 10)
+              return false;
+          cents = cents * 10 + (text[i] - '0');
+          digits = true;
+      }
+      cents *= 100;
+
+      // cents, rounded on the third decimal
+      if (i != text.size() && text[i] == '.')
+      {
+          int place = 0;
+          for (i++; i != text.size() && std::isdigit(static_cast<unsigned char>(text[i])); i++, place++)
+          {
+              int digit = text[i] - '0';
+              if (place == 0)
+                  cents += digit * 10;
+              else if (place == 1)
+                  cents += digit;
+              else if (place == 2 && digit >= 5)
+                  cents += 1;
+              digits = true;
+          }
+      }
+      if (!digits || i != text.size())
+          return false;
+      out.value = negative ? -cents : cents;
+      return true;
+  }
+
+  bool parseKey(std::string_view text, std::int64_t &out)
+  {
+      std::int64_t parts[3] = { 0, 0, 0 };
+      int digits[3] = { 0, 0, 0 };
+      std::size_t part = 0;
+      char sep = '\0';
+
+      // up to three groups of digits, split by the same '/' or '-'
+      text = trim(text);
+      for (std::size_t i = 0; i != text.size() && part != 3; i++)
+      {
+          if (std::isdigit(static_cast<unsigned char>(text[i])) && digits[part] < 4)
+          {
+              parts[part] = parts[part] * 10 + (text[i] - '0');
+              digits[part]++;
+          }
+          else if ((text[i] == '/' || text[i] == '-') && part < 2 && digits[part] != 0
+                   && (sep == '\0' || sep == text[i]))
+          {
+              sep = text[i];
+              part++;
+          }
+          else
+              part = 3;
+      }
+
+      std::int64_t year = 0, month = 0, day = 0;
+      if (part == 2 && sep == '/' && digits[0] <= 2 && digits[1] <= 2 && digits[2] == 4)
+      {
+          month = parts[0];
+          day = parts[1];
+          year = parts[2];
+      }
+      else if (part == 2 && sep == '-' && digits[0] == 4 && digits[1] <= 2 && digits[2] != 0
+               && digits[2] <= 2)
+      {
+          year = parts[0];
+          month = parts[1];
+          day = parts[2];
+      }
+      if (month >= 1 && month <= 12 && day >= 1 && day <= 31)
+      {
+          out = year * 10000 + month * 100 + day;
+          return true;
+      }
+
+      Cents cents;
+      if (!parseCurrency(text, cents))
+          return false;
+      out = cents.value;
+      return true;
+  }
+
+  Parser::Parser(const std::string &data, const DataType &type, char sep,
+                 const Options &options)
+    : _type(type), _sep(sep), _options(options),
+      _split(tokenizerFor(sep, options.quote, options.escape, options.trim)), _contentStart(0),
+      _columnsStale(false), _parsedEnd(0), _tailHash(0),
+      _dirtyFrom(static_cast<std::size_t>(-1)), _mirrorsFile(false),
+      _compressed(type != ePURE && Source::isCompressed(data)),
+      _lines(static_cast<std::uint64_t>(-1)), _lazyRows(false), _indexSaved(false), _rows(0)
+  {
+      _header._owner = this;
+      if (options.lazy && options.columnar)
+        throw Error("can't parse lazily in columnar mode");
+      if (type != ePURE && options.snapshot && !options.lazy)
+      {
+        _file = data;
+        if (loadSnapshot())
+          return;
+      }
+
+      Clock::time_point start = Clock::now();
+      std::ifstream ifile;
+      if (_compressed)
+      {
+        _file = data;
+        readCompressed();
+      }
+      else if (type == eFILE)
+      {
+        _file = data;
+        ifile.open(_file.c_str(), std::ios::in | std::ios::binary);
+        if (!ifile.is_open())
+            throw Error(std::string("Failed to open ").append(_file));
+
+        ifile.seekg(0, std::ios::end);
+        _buffer.resize(static_cast<std::size_t>(ifile.tellg()));
+        ifile.seekg(0, std::ios::beg);
+        if (options.readAhead && !options.lazy)
+        {
+          // the destructor won't run if the content turns out corrupted
+          try
+          {
+            parseStreamed(ifile);
+            trackTail(_buffer.size());
+            _mirrorsFile = true;
+            if (_options.snapshot)
+              saveSnapshot();
+          }
+          catch (...)
+          {
+            for (auto it = _content.begin(); it != _content.end(); it++)
+              release(*it);
+            throw;
+          }
+          return;
+        }
+        ifile.read(&_buffer[0], _buffer.size());
+        ifile.close();
+        _data = _buffer;
+      }
+      else if (type == eMAPPED)
+      {
+        _file = data;
+        if (!_mapping.open(_file))
+            throw Error(std::string("Failed to open ").append(_file));
+        _data = std::string_view(_mapping.data(), _mapping.size());
+      }
+      else
+      {
+        _buffer = data;
+        _data = _buffer;
+      }
+      if (_options.stats)
+      {
+        _stats.readNs += nanoseconds(start);
+        _stats.bytes += _data.size();
+      }
+
+      parseHeader();
+      if (_header.size() == 0)
+      {
+        if (type == ePURE)
+          throw Error(std::string("No Data in pure content"));
+        throw Error(std::string("No Data in ").append(_file));
+      }
+      selectColumns();
+      encodeColumns();
+
+      // the destructor won't run if the content turns out corrupted
+      try
+      {
+        std::uint64_t end = _data.size();
+        if (_options.lazy)
+          indexContent();
+        else
+          parseContent();
+        if (type != ePURE && !_compressed)
+          trackTail(end);
+        // a columnar parse keeps no copy of the input
+        _mirrorsFile = (type != ePURE && !_compressed && !_data.empty());
+        if (type != ePURE && _options.snapshot && !_options.lazy)
+          saveSnapshot();
+      }
+      catch (...)
+      {
+        for (auto it = _content.begin(); it != _content.end(); it++)
+          release(*it);
+        throw;
+      }
+  }
+
+  Parser::~Parser(void)
+  {
+     std::vector<Row *>::iterator it;
+
+     for (it = _content.begin(); it != _content.end(); it++)
+          release(*it);
+     for (auto gap = _gaps.begin(); gap != _gaps.end(); gap++)
+         for (it = gap->second.begin(); it != gap->second.end(); it++)
+             release(*it);
+  }
+
+  Row *Parser::newRow(Arena *arena) const
+  {
+      if (arena == nullptr)
+          return new Row(_header);
+      return new (arena->allocate(sizeof(Row), alignof(Row))) Row(_header, arena);
+  }
+
+  /*
+  ** Frees a row from newRow(). An arena row only needs its destructor
+  ** once push() or set() gave it a block of its own: its values are in
+  ** the arena, which frees them with its blocks.
+  */
+  void Parser::release(Row *row)
+  {
+      if (row == nullptr)
+          return;
+      if (row->_values.get_allocator().arena() == nullptr)
+          delete row;
+      else if (row->_owned)
+          row->~Row();
+  }
+
+  void Parser::parseHeader(void)
+  {
+      std::vector<std::string_view> fields;
+      std::vector<std::string> names;
+      std::size_t pos = 0;
+
+      // skip leading blank lines
+      while (pos != _data.size())
+      {
+          pos = nextRecord(_data, _split(_data, pos, _sep, fields));
+          if (!isBlank(fields))
+          {
+              for (auto it = fields.begin(); it != fields.end(); it++)
+                  names.push_back(std::string(*it));
+              break;
+          }
+      }
+      _header = Header(names);
+      _contentStart = pos;
+  }
+
+  void Parser::selectColumns(void)
+  {
+      if (_options.columns.empty() && _options.columnNames.empty()
+          && _options.columnAliases.empty())
+          return;
+
+      _selected.assign(_header.size(), false);
+      for (auto it = _options.columns.begin(); it != _options.columns.end(); it++)
+      {
+          if (*it >= _header.size())
+              throw Error("can't select this column (doesn't exist)");
+          _selected[*it] = true;
+      }
+      for (auto it = _options.columnNames.begin(); it != _options.columnNames.end(); it++)
+      {
+          int pos = _header.find(*it);
+          if (pos < 0)
+              throw Error(std::string("can't select this column (doesn't exist) : ").append(*it));
+          _selected[pos] = true;
+      }
+      for (auto it = _options.columnAliases.begin(); it != _options.columnAliases.end(); it++)
+      {
+          int pos = _header.find(*it);
+          if (pos < 0)
+              throw Error(std::string("can't select this column (doesn't exist) : ")
+                          .append(it->empty() ? std::string() : it->front()));
+          _selected[pos] = true;
+      }
+      _header.select(_selected);
+  }
+
+  /*
+  ** Finds which columns to dictionary encode, once the header is known.
+  */
+  void Parser::encodeColumns(void)
+  {
+      if (_options.dictionary.empty() && _options.dictionaryNames.empty())
+          return;
+
+      _encoded.assign(_header.size(), false);
+      for (auto it = _options.dictionary.begin(); it != _options.dictionary.end(); it++)
+      {
+          if (*it >= _header.size())
+              throw Error("can't encode this column (doesn't exist)");
+          _encoded[*it] = true;
+      }
+      for (auto it = _options.dictionaryNames.begin(); it != _options.dictionaryNames.end(); it++)
+      {
+          int pos = _header.find(*it);
+          if (pos < 0)
+              throw Error(std::string("can't encode this column (doesn't exist) : ").append(*it));
+          _encoded[pos] = true;
+      }
+  }
+
+  /*
+  ** Sets `columns` to one empty column per header field, dictionary
+  ** encoded as the options ask.
+  */
+  void Parser::makeColumns(std::vector<Column> &columns) const
+  {
+      columns.clear();
+      for (unsigned int i = 0; i != _header.size(); i++)
+          columns.emplace_back(!_encoded.empty() && _encoded[i]);
+  }
+
+  void Parser::parseContent(void)
+  {
+     unsigned int threads = _options.threads;
+
+     if (threads == 0)
+         threads = std::max(1u, std::thread::hardware_concurrency());
+     // not worth a thread below this many bytes per chunk
+     threads = static_cast<unsigned int>(std::min<std::size_t>(
+         threads, (_data.size() - _contentStart) / (256 * 1024) + 1));
+     // chunks are found from the quote parity, which escapes break
+     if (_options.escape != '\0' && _options.escape != _options.quote)
+         threads = 1;
+
+     std::size_t records;
+
+     if (_options.columnar)
+         makeColumns(_columns);
+     if (_options.arena)
+         for (unsigned int t = 0; t != threads; t++)
+             _arenas.emplace_back(new Arena());
+     if (threads > 1)
+         records = parseParallel(threads);
+     else
+         records = parseRange(_data, _contentStart, _data.size(), _content, _columns,
+                              _arenas.empty() ? nullptr : _arenas[0].get(),
+                              _options.stats ? &_stats : nullptr,
+                              _options.lenient ? &_badRecords : nullptr);
+     numberLines(_data, 0, 1, _badRecords.begin(), _badRecords.end());
+     finishContent(records);
+  }
+
+  /*
+  ** Parses the file while it is being read: a background thread reads
+  ** it block by block into _buffer, already sized for the whole file,
+  ** and the records are tokenized as soon as they are complete.
+  */
+  void Parser::parseStreamed(std::ifstream &in)
+  {
+     BlockLoader loader(in, &_buffer[0], _buffer.size());
+     std::size_t read = 0;
+     bool done = false;
+
+     // the header is the first record that isn't blank
+     do
+     {
+         Clock::time_point start = Clock::now();
+         read = loader.waitPast(read, done);
+         if (_options.stats)
+             _stats.readNs += nanoseconds(start);
+         _data = std::string_view(_buffer.data(), done ? read : completeLength(
+             std::string_view(_buffer.data(), read), _options.quote, _options.escape));
+         parseHeader();
+     } while (_header.size() == 0 && !done);
+     if (_header.size() == 0)
+         throw Error(std::string("No Data in ").append(_file));
+     selectColumns();
+     encodeColumns();
+
+     if (_options.columnar)
+         makeColumns(_columns);
+     if (_options.arena)
+         _arenas.emplace_back(new Arena());
+
+     std::size_t parsed = _contentStart;
+     std::size_t records = 0;
+     while (true)
+     {
+         std::size_t end = done ? read : parsed + completeLength(
+             std::string_view(_buffer.data() + parsed, read - parsed), _options.quote,
+             _options.escape);
+         _data = std::string_view(_buffer.data(), end);
+         records += parseRange(_data, parsed, end, _content, _columns,
+                               _arenas.empty() ? nullptr : _arenas[0].get(),
+                               _options.stats ? &_stats : nullptr,
+                               _options.lenient ? &_badRecords : nullptr);
+         parsed = end;
+         if (done)
+             break;
+         Clock::time_point start = Clock::now();
+         read = loader.waitPast(read, done);
+         if (_options.stats)
+             _stats.readNs += nanoseconds(start);
+     }
+     if (read != _buffer.size())
+         throw Error(std::string("Failed to read ").append(_file));
+     if (_options.stats)
+         _stats.bytes += read;
+     numberLines(_data, 0, 1, _badRecords.begin(), _badRecords.end());
+     finishContent(records);
+  }
+
+  /*
+  ** Decompresses the whole file into _buffer, growing it as needed.
+  */
+  void Parser::readCompressed(void)
+  {
+     std::unique_ptr<Source> source = Source::open(_file);
+     const std::size_t block = 1 << 20;
+     std::size_t size = 0;
+
+     while (true)
+     {
+         _buffer.resize(std::max(size + block, _buffer.size() * 2));
+         std::size_t wanted = _buffer.size() - size;
+         std::size_t count = source->read(&_buffer[size], wanted);
+         size += count;
+         if (count < wanted)
+             break;
+     }
+     _buffer.resize(size);
+     _data = _buffer;
+  }
+
+  void Parser::finishContent(std::size_t records)
+  {
+     if (_options.columnar)
+     {
+         // every value now lives in a column, the input is not needed
+         _content.resize(records, nullptr);
+         _mapping.close();
+         _buffer = std::string();
+         _data = std::string_view();
+     }
+  }
+
+  /*
+  ** Tokenizes the records of `data` starting in [begin, end) into rows, or onto
+  ** the end of `columns` in columnar mode, and returns how many records
+  ** it read; `begin` must be the start of a record. Counts and times
+  ** the work into `stats` unless it is null. A record with the wrong
+  ** number of fields throws, or is added to `rejected` unless that is
+  ** null; its line is left for numberLines().
+  */
+  std::size_t Parser::parseRange(std::string_view data, std::size_t begin, std::size_t end,
+                                 std::vector<Row *> &rows, std::vector<Column> &columns,
+                                 Arena *arena, Stats *stats,
+                                 std::vector<BadRecord> *rejected) const
+  {
+     std::vector<std::string_view> fields;
+     std::size_t pos = begin;
+     std::size_t records = 0;
+
+     fields.reserve(_header.size());
+     while (pos < end)
+     {
+         std::size_t record = pos;
+         Clock::time_point start;
+         if (stats != nullptr)
+             start = Clock::now();
+         pos = nextRecord(data, _split(data, pos, _sep, fields));
+         if (stats != nullptr)
+         {
+             stats->tokenizeNs += nanoseconds(start);
+             countRecord(*stats, fields, _options.quote);
+         }
+         if (isBlank(fields))
+             continue;
+
+         // if value(s) missing
+         if (fields.size() != _header.size())
+         {
+          if (rejected == nullptr)
+            throw Error("corrupted data !");
+          rejected->push_back(BadRecord{0, record, std::string("expected ")
+              .append(std::to_string(_header.size())).append(" fields, found ")
+              .append(std::to_string(fields.size()))});
+          continue;
+         }
+         records++;
+         if (stats != nullptr)
+             start = Clock::now();
+         addRecord(fields, rows, columns, arena, stats);
+         if (stats != nullptr)
+             stats->buildNs += nanoseconds(start);
+     }
+     return records;
+  }
+
+  /*
+  ** Stores one record as a row, or onto the end of `columns` in
+  ** columnar mode, dropping the columns that are not selected. Counts
+  ** the heap blocks taken into `stats` unless it is null; arena blocks
+  ** are counted by stats().
+  */
+  void Parser::addRecord(std::vector<std::string_view> &fields, std::vector<Row *> &rows,
+                         std::vector<Column> &columns, Arena *arena, Stats *stats) const
+  {
+     // unselected columns are never pushed to
+     if (_options.columnar && !_columnsStale)
+     {
+         for (unsigned int i = 0; i != fields.size(); i++)
+         {
+             if (!isSelected(i))
+                 continue;
+             if (stats == nullptr)
+             {
+                 columns[i].push(fields[i]);
+                 continue;
+             }
+             std::size_t bytes = columns[i]._bytes.capacity();
+             std::size_t offsets = columns[i]._offsets.capacity();
+             std::size_t codes = columns[i]._codes.capacity();
+             std::size_t distinct = columns[i]._values.size();
+             columns[i].push(fields[i]);
+             // a new dictionary value takes at least an index node
+             stats->allocations += (bytes != columns[i]._bytes.capacity())
+                 + (offsets != columns[i]._offsets.capacity())
+                 + (codes != columns[i]._codes.capacity())
+                 + (distinct != columns[i]._values.size());
+         }
+         return;
+     }
+
+     std::size_t capacity = rows.capacity();
+     Row *row = newRow(arena);
+     if (_header._slots.empty())
+         row->_values.assign(fields.begin(), fields.end());
+     else
+     {
+         row->_values.reserve(_header._kept);
+         for (unsigned int i = 0; i != fields.size(); i++)
+             if (_selected[i])
+                 row->_values.push_back(fields[i]);
+     }
+     rows.push_back(row);
+     // the row and its values, unless they are in the arena
+     if (stats != nullptr)
+         stats->allocations += (arena == nullptr ? 2 : 0) + (capacity != rows.capacity());
+  }
+
+  /*
+  ** Restores the table from <file>.snap when the snapshot was written
+  ** for the file as it is now (same size, modification time and content
+  ** hash), with the same dialect and column selection, and its table
+  ** hash matches. Rows then point straight into the mapped snapshot.
+  */
+  bool Parser::loadSnapshot(void)
+  {
+      Clock::time_point since = Clock::now();
+      std::uint64_t fileSize;
+      std::int64_t fileTime;
+      SnapshotHeader head;
+
+      if (!fileStamp(_file, fileSize, fileTime) || !_mapping.open(_file + ".snap"))
+          return false;
+
+      const char *begin = _mapping.data();
+      const char *table = begin + sizeof(head);
+      bool valid = _mapping.size() >= sizeof(head);
+
+      if (valid)
+      {
+          std::memcpy(&head, begin, sizeof(head));
+          valid = std::memcmp(head.magic, SNAPSHOT_MAGIC, sizeof(head.magic)) == 0
+              && head.version == SNAPSHOT_VERSION && head.fileSize == fileSize
+              && head.fileTime == fileTime && head.dialect == dialectCode(_sep, _options)
+              && head.columns != 0 && head.kept != 0 && head.kept <= head.columns
+              && head.tableSize <= _mapping.size() - sizeof(head)
+              && head.bytesSize == _mapping.size() - sizeof(head) - head.tableSize
+              && wordHash(table, static_cast<std::size_t>(head.tableSize)) == head.tableHash;
+      }
+
+      const char *end = table + (valid ? head.tableSize : 0);
+      std::vector<std::string> names;
+      const char *pos = table;
+      for (std::uint64_t i = 0; valid && i != head.columns; i++)
+      {
+          std::uint32_t length;
+          valid = end - pos >= static_cast<std::ptrdiff_t>(sizeof(length));
+          if (valid)
+          {
+              std::memcpy(&length, pos, sizeof(length));
+              pos += sizeof(length);
+              valid = static_cast<std::uint64_t>(end - pos) >= length;
+          }
+          if (valid)
+          {
+              names.push_back(std::string(pos, length));
+              pos += length;
+          }
+      }
+
+      if (valid)
+      {
+          _header = Header(names);
+          selectColumns();
+          encodeColumns();
+          std::uint64_t selection = FNV_OFFSET;
+          for (auto it = _selected.begin(); it != _selected.end(); it++)
+              selection = fnv1a(selection, *it ? "1" : "0", 1);
+          std::uint64_t hash;
+          valid = selection == head.selection && _header._kept == head.kept
+              && fileHash(_file, fileSize, hash) && hash == head.fileHash;
+      }
+      if (!valid)
+      {
+          _header = Header();
+          _selected.clear();
+          _encoded.clear();
+          _mapping.close();
+          return false;
+      }
+
+      _data = std::string_view(end, static_cast<std::size_t>(head.bytesSize));
+      Stats *stats = _options.stats ? &_stats : nullptr;
+      if (stats != nullptr)
+      {
+          stats->readNs += nanoseconds(since);
+          stats->bytes += _mapping.size();
+          since = Clock::now();
+      }
+      if (_options.columnar)
+          makeColumns(_columns);
+      if (_options.arena)
+          _arenas.emplace_back(new Arena());
+
+      // the columns left out stay empty
+      std::vector<unsigned int> kept;
+      for (unsigned int i = 0; i != _header.size(); i++)
+          if (isSelected(i))
+              kept.push_back(i);
+      std::vector<std::string_view> record(head.columns);
+      const unsigned char *length = reinterpret_cast<const unsigned char *>(pos);
+      const unsigned char *lengths = reinterpret_cast<const unsigned char *>(end);
+      std::uint64_t start = 0;
+      _content.reserve(_options.columnar ? 0 : head.rows);
+      for (std::uint64_t row = 0; valid && row != head.rows; row++)
+      {
+          for (auto column = kept.begin(); valid && column != kept.end(); column++)
+          {
+              std::uint64_t size = 0;
+              for (int shift = 0; length != lengths && shift < 64; shift += 7)
+              {
+                  size |= static_cast<std::uint64_t>(*length & 0x7F) << shift;
+                  if (!(*length++ & 0x80))
+                      break;
+              }
+              valid = size <= head.bytesSize - start;
+              record[*column] = _data.substr(static_cast<std::size_t>(start),
+                                             static_cast<std::size_t>(size));
+              start += size;
+          }
+          if (!valid)
+              break;
+          if (stats != nullptr)
+              countRecord(*stats, record, _options.quote);
+          addRecord(record, _content, _columns, _arenas.empty() ? nullptr : _arenas[0].get(),
+                    stats);
+      }
+
+      // a table out of step with the bytes, left for a parse
+      if (!valid || length != lengths || start != head.bytesSize)
+      {
+          for (auto it = _content.begin(); it != _content.end(); it++)
+              release(*it);
+          _content.clear();
+          _columns.clear();
+          _arenas.clear();
+          _header = Header();
+          _selected.clear();
+          _encoded.clear();
+          _data = std::string_view();
+          _mapping.close();
+          if (stats != nullptr)
+              *stats = Stats();
+          return false;
+      }
+      if (stats != nullptr)
+          stats->buildNs += nanoseconds(since);
+      finishContent(head.rows);
+      trackTail(fileSize);
+      return true;
+  }
+
+  /*
+  ** Writes <file>.snap for the table just parsed. The snapshot is only a
+  ** cache, so failing to write it is not an error. None is written while
+  ** records are set aside, which it could not report again.
+  */
+  void Parser::saveSnapshot(void) const
+  {
+      SnapshotHeader head;
+      std::string temp = _file + ".snap.tmp";
+      std::int64_t fileTime;
+      std::uint64_t fileSize;
+
+      if (!_badRecords.empty() || !fileStamp(_file, fileSize, fileTime)
+          || !fileHash(_file, fileSize, head.fileHash))
+          return;
+
+      std::memcpy(head.magic, SNAPSHOT_MAGIC, sizeof(head.magic));
+      head.version = SNAPSHOT_VERSION;
+      head.fileSize = fileSize;
+      head.fileTime = fileTime;
+      head.selection = FNV_OFFSET;
+      for (auto it = _selected.begin(); it != _selected.end(); it++)
+          head.selection = fnv1a(head.selection, *it ? "1" : "0", 1);
+      head.dialect = dialectCode(_sep, _options);
+      head.columns = _header.size();
+      head.kept = _header._kept;
+      head.rows = _content.size();
+
+      std::string table;
+      for (unsigned int i = 0; i != _header.size(); i++)
+      {
+          std::uint32_t length = static_cast<std::uint32_t>(_header[i].size());
+          table.append(reinterpret_cast<const char *>(&length), sizeof(length));
+          table.append(_header[i]);
+      }
+
+      std::vector<unsigned int> kept;
+      for (unsigned int i = 0; i != _header.size(); i++)
+          if (isSelected(i))
+              kept.push_back(i);
+
+      head.bytesSize = 0;
+      table.reserve(table.size() + head.rows * head.kept);
+      for (unsigned int row = 0; row != _content.size(); row++)
+          for (auto column = kept.begin(); column != kept.end(); column++)
+          {
+              std::uint64_t size = field(row, *column).size();
+              head.bytesSize += size;
+              for (; size >= 0x80; size >>= 7)
+                  table.push_back(static_cast<char>(size | 0x80));
+              table.push_back(static_cast<char>(size));
+          }
+      head.tableSize = table.size();
+      head.tableHash = wordHash(table.data(), table.size());
+
+      std::ofstream out(temp.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+      if (!out.is_open())
+          return;
+      out.write(reinterpret_cast<const char *>(&head), sizeof(head));
+      out.write(table.data(), table.size());
+      for (unsigned int row = 0; row != _content.size(); row++)
+          for (auto column = kept.begin(); column != kept.end(); column++)
+          {
+              std::string_view value = field(row, *column);
+              out.write(value.data(), value.size());
+          }
+      out.close();
+
+      std::error_code error;
+      if (out)
+          std::filesystem::rename(temp, _file + ".snap", error);
+      if (!out || error)
+          std::filesystem::remove(temp, error);
+  }
+
+  /*
+  ** Finds where every record starts, from <file>.idx when it was written
+  ** for the file as it is now, so that rows are only tokenized when used.
+  */
+  void Parser::indexContent(void)
+  {
+      if (_options.arena)
+          _arenas.emplace_back(new Arena());
+      if (_type == ePURE || !loadIndex())
+      {
+          indexRange(_data, _contentStart, _data.size(), 0,
+                     _options.stats ? &_stats : nullptr, _options.lenient ? &_badRecords : nullptr);
+          numberLines(_data, 0, 1, _badRecords.begin(), _badRecords.end());
+          if (_type != ePURE)
+              saveIndex();
+      }
+      _content.assign(_starts.size(), nullptr);
+      _lazyRows = true;
+  }
+
+  /*
+  ** Adds where the records of `data` starting in [begin, end) start to
+  ** _starts, `base` being where `data` is in the file. Records are
+  ** checked as parseRange() does.
+  */
+  void Parser::indexRange(std::string_view data, std::size_t begin, std::size_t end,
+                          std::uint64_t base, Stats *stats, std::vector<BadRecord> *rejected)
+  {
+      std::vector<std::string_view> fields;
+      std::size_t pos = begin;
+
+      fields.reserve(_header.size());
+      while (pos < end)
+      {
+          std::size_t record = pos;
+          Clock::time_point start;
+          if (stats != nullptr)
+              start = Clock::now();
+          pos = nextRecord(data, _split(data, pos, _sep, fields));
+          if (stats != nullptr)
+          {
+              stats->tokenizeNs += nanoseconds(start);
+              countRecord(*stats, fields, _options.quote);
+          }
+          if (isBlank(fields))
+              continue;
+
+          if (fields.size() != _header.size())
+          {
+              if (rejected == nullptr)
+                  throw Error("corrupted data !");
+              rejected->push_back(BadRecord{0, base + record, std::string("expected ")
+                  .append(std::to_string(_header.size())).append(" fields, found ")
+                  .append(std::to_string(fields.size()))});
+              continue;
+          }
+          _starts.push_back(base + record);
+      }
+  }
+
+  /*
+  ** Reads _starts from <file>.idx if it was written for the file as it
+  ** is now (same size, time and dialect) and is intact.
+  */
+  bool Parser::loadIndex(void)
+  {
+      std::uint64_t fileSize;
+      std::int64_t fileTime;
+      IndexHeader head;
+
+      std::ifstream in((_file + ".idx").c_str(), std::ios::in | std::ios::binary);
+      if (!fileStamp(_file, fileSize, fileTime)
+          || !in.read(reinterpret_cast<char *>(&head), sizeof(head))
+          || std::memcmp(head.magic, INDEX_MAGIC, sizeof(head.magic)) != 0
+          || head.version != INDEX_VERSION || head.fileSize != fileSize
+          || head.fileTime != fileTime || head.dialect != dialectCode(_sep, _options)
+          || head.records > _data.size() || head.fileHash != sampleHash(_file, fileSize))
+          return false;
+
+      std::vector<std::uint64_t> starts(static_cast<std::size_t>(head.records));
+      if (!in.read(reinterpret_cast<char *>(starts.data()), starts.size() * sizeof(std::uint64_t))
+          || in.peek() != std::ifstream::traits_type::eof()
+          || fnv1a(FNV_OFFSET, starts.data(), starts.size() * sizeof(std::uint64_t))
+             != head.payloadHash)
+          return false;
+      // records are tokenized from these, so they must lie in the content
+      for (std::size_t i = 0; i != starts.size(); i++)
+          if (starts[i] < (i == 0 ? _contentStart : starts[i - 1] + 1) || starts[i] >= _data.size())
+              return false;
+
+      _starts.swap(starts);
+      _indexSaved = true;
+      return true;
+  }
+
+  /*
+  ** Writes <file>.idx; like the snapshot it is only a cache, and is not
+  ** written while records are set aside.
+  */
+  void Parser::saveIndex(void) const
+  {
+      IndexHeader head;
+      std::string temp = _file + ".idx.tmp";
+
+      if (!_badRecords.empty() || !fileStamp(_file, head.fileSize, head.fileTime))
+          return;
+
+      std::memcpy(head.magic, INDEX_MAGIC, sizeof(head.magic));
+      head.version = INDEX_VERSION;
+      head.fileHash = sampleHash(_file, head.fileSize);
+      head.dialect = dialectCode(_sep, _options);
+      head.records = _starts.size();
+      head.payloadHash = fnv1a(FNV_OFFSET, _starts.data(), _starts.size() * sizeof(std::uint64_t));
+
+      std::ofstream out(temp.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+      if (!out.is_open())
+          return;
+      out.write(reinterpret_cast<const char *>(&head), sizeof(head));
+      out.write(reinterpret_cast<const char *>(_starts.data()), _starts.size() * sizeof(std::uint64_t));
+      out.close();
+
+      std::error_code error;
+      if (out)
+          std::filesystem::rename(temp, _file + ".idx", error);
+      if (!out || error)
+          std::filesystem::remove(temp, error);
+      _indexSaved = out && !error;
+  }
+
+  /*
+  ** Adds the starts from `from` on to <file>.idx, which holds those
+  ** before, once they cover the whole file; drops the index otherwise.
+  */
+  void Parser::appendIndex(std::size_t from) const
+  {
+      std::string path = _file + ".idx";
+      std::fstream io(path.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+      const char *bytes = reinterpret_cast<const char *>(_starts.data() + from);
+      std::size_t size = (_starts.size() - from) * sizeof(std::uint64_t);
+      IndexHeader head;
+
+      bool valid = io.read(reinterpret_cast<char *>(&head), sizeof(head))
+          && std::memcmp(head.magic, INDEX_MAGIC, sizeof(head.magic)) == 0
+          && head.version == INDEX_VERSION && head.records == from
+          && fileStamp(_file, head.fileSize, head.fileTime) && head.fileSize == _parsedEnd;
+      if (valid)
+      {
+          head.fileHash = sampleHash(_file, head.fileSize);
+          head.records = _starts.size();
+          head.payloadHash = fnv1a(head.payloadHash, bytes, size);
+          io.seekp(static_cast<std::streamoff>(sizeof(head) + from * sizeof(std::uint64_t)));
+          io.write(bytes, size);
+          io.seekp(0);
+          io.write(reinterpret_cast<const char *>(&head), sizeof(head));
+          valid = io.good();
+      }
+      io.close();
+
+      std::error_code error;
+      if (!valid)
+          std::filesystem::remove(path, error);
+      _indexSaved = valid;
+  }
+
+  /*
+  ** Tokenizes the record of a row not built yet in lazy mode.
+  */
+  Row *Parser::buildRow(std::size_t row) const
+  {
+      std::vector<std::string_view> fields;
+      std::vector<Row *> rows;
+      std::vector<Column> columns;
+
+      fields.reserve(_header.size());
+      _split(_data, static_cast<std::size_t>(_starts[row]), _sep, fields);
+      if (fields.size() != _header.size())
+          throw Error("corrupted data !");
+      addRecord(fields, rows, columns, _arenas.empty() ? nullptr : _arenas[0].get(), nullptr);
+      return rows.back();
+  }
+
+  /*
+  ** Rows whose value in `column` has a key (see parseKey()) in [low,
+  ** high], in order. Every block of RANGE_BLOCK rows keeps the smallest
+  ** and largest key of the column, so only blocks that may hold such a
+  ** key are read. The ranges are worked out on the first scan of the
+  ** column and carried over to the rows refresh() adds; the blocks from
+  ** the first row addRow() or deleteRow() moved on, and those of the rows
+  ** Row::set() changed, are worked out again on the next scan. In
+  ** columnar and lazy modes no row is built to be read.
+  */
+  std::vector<unsigned int> Parser::scan(unsigned int column, std::int64_t low,
+                                         std::int64_t high) const
+  {
+      if (column >= _header.size())
+          throw Error("can't scan this column (doesn't exist)");
+      compact();
+      updateRanges(column);
+
+      const Ranges &ranges = _ranges[column];
+      std::vector<unsigned int> rows;
+      std::vector<std::string_view> fields;
+      std::int64_t key;
+      for (std::size_t block = 0; block != ranges.low.size(); block++)
+      {
+          if (ranges.high[block] < low || ranges.low[block] > high)
+              continue;
+          std::size_t end = std::min(_content.size(), (block + 1) * RANGE_BLOCK);
+          for (std::size_t row = block * RANGE_BLOCK; row != end; row++)
+          {
+              std::string_view value = field(static_cast<unsigned int>(row), column, &fields);
+              if (parseKey(value, key) && key >= low && key <= high)
+                  rows.push_back(static_cast<unsigned int>(row));
+          }
+      }
+      return rows;
+  }
+
+  std::vector<unsigned int> Parser::scan(const std::string &column, std::int64_t low,
+                                         std::int64_t high) const
+  {
+      int pos = _header.find(column);
+      if (pos < 0)
+          throw Error(std::string("can't scan this column (doesn't exist) : ").append(column));
+      return scan(static_cast<unsigned int>(pos), low, high);
+  }
+
+  /*
+  ** Works out the ranges of `column` for the rows it has none for yet
+  ** and for its dirty blocks; the last block is worked out again as it
+  ** may have grown or shrunk. A block without any key gets an empty
+  ** range (low above high).
+  */
+  void Parser::updateRanges(unsigned int column) const
+  {
+      _ranges.resize(_header.size());
+
+      // every column's blocks holding a row edited since
+      if (!_edited.empty())
+      {
+          std::sort(_edited.begin(), _edited.end());
+          for (std::size_t row = 0; row != _content.size(); row++)
+              if (std::binary_search(_edited.begin(), _edited.end(), _content[row]))
+                  for (auto it = _ranges.begin(); it != _ranges.end(); it++)
+                      if (it->dirty.empty() || it->dirty.back() != row / RANGE_BLOCK)
+                          it->dirty.push_back(row / RANGE_BLOCK);
+          _edited.clear();
+      }
+
+      Ranges &ranges = _ranges[column];
+      std::size_t blocks = (_content.size() + RANGE_BLOCK - 1) / RANGE_BLOCK;
+      if (ranges.rows == _content.size() && ranges.low.size() == blocks && ranges.dirty.empty())
+          return;
+
+      std::vector<std::string_view> fields;
+      fields.reserve(_header.size());
+      auto work = [&](std::size_t block) {
+          std::int64_t low = std::numeric_limits<std::int64_t>::max();
+          std::int64_t high = std::numeric_limits<std::int64_t>::min();
+          std::int64_t key;
+          std::size_t end = std::min(_content.size(), (block + 1) * RANGE_BLOCK);
+          for (std::size_t row = block * RANGE_BLOCK; row != end; row++)
+          {
+              if (!parseKey(field(static_cast<unsigned int>(row), column, &fields), key))
+                  continue;
+              low = std::min(low, key);
+              high = std::max(high, key);
+          }
+          ranges.low[block] = low;
+          ranges.high[block] = high;
+      };
+
+      std::size_t first = ranges.rows / RANGE_BLOCK;
+      ranges.low.resize(blocks);
+      ranges.high.resize(blocks);
+      for (auto it = ranges.dirty.begin(); it != ranges.dirty.end(); it++)
+          if (*it < first)
+              work(*it);
+      for (std::size_t block = first; block < blocks; block++)
+          work(block);
+      ranges.dirty.clear();
+      ranges.rows = _content.size();
+  }
+
+  /*
+  ** Value of a cell without building its row in columnar mode, nor in
+  ** lazy mode when given `fields` to tokenize the record into.
+  */
+  std::string_view Parser::field(unsigned int row, unsigned int column,
+                                 std::vector<std::string_view> *fields) const
+  {
+      if (_options.columnar && !_columnsStale)
+          return isSelected(column) ? _columns[column][row] : std::string_view();
+      if (fields != nullptr && _lazyRows && _content[row] == nullptr)
+      {
+          _split(_data, static_cast<std::size_t>(_starts[row]), _sep, *fields);
+          if (fields->size() != _header.size())
+              throw Error("corrupted data !");
+          return isSelected(column) ? (*fields)[column] : std::string_view();
+      }
+      return getRow(row).value(column);
+  }
+
+  /*
+  ** Splits the content into one byte range per thread. A range may start
+  ** inside a quoted field, so the quote parity of every range is counted
+  ** first; from it each range knows whether it starts quoted and moves
+  ** its start to the first record boundary after it. The rows of every
+  ** range are then appended in order, so row numbers are unchanged.
+  */
+  std::size_t Parser::parseParallel(unsigned int threads)
+  {
+     std::size_t length = _data.size() - _contentStart;
+     std::vector<std::size_t> bounds(threads + 1);
+     std::vector<char> oddQuotes(threads);
+     std::vector<std::thread> workers;
+
+     for (unsigned int t = 0; t != threads; t++)
+         bounds[t] = _contentStart + length / threads * t;
+     bounds[threads] = _data.size();
+
+     for (unsigned int t = 0; t != threads; t++)
+         workers.emplace_back([this, t, &bounds, &oddQuotes]() {
+             oddQuotes[t] = (_options.quote != '\0')
+                 && (std::count(_data.begin() + bounds[t], _data.begin() + bounds[t + 1], _options.quote) & 1);
+         });
+     for (auto it = workers.begin(); it != workers.end(); it++)
+         it->join();
+     workers.clear();
+
+     bool quoted = false;
+     for (unsigned int t = 1; t != threads; t++)
+     {
+         quoted ^= (oddQuotes[t - 1] != 0);
+
+         std::size_t pos = bounds[t];
+         bool inside = quoted;
+         while (pos != _data.size() && (inside || _data[pos] != '\n'))
+         {
+             if (_options.quote != '\0' && _data[pos] == _options.quote)
+                 inside = !inside;
+             pos++;
+         }
+         bounds[t] = std::max(bounds[t - 1], nextRecord(_data, pos));
+     }
+
+     std::vector<std::vector<Row *> > chunks(threads);
+     std::vector<std::size_t> records(threads);
+     std::vector<std::vector<Column> > columns(threads);
+     for (unsigned int t = 0; t != threads && !_columns.empty(); t++)
+         makeColumns(columns[t]);
+     std::vector<std::exception_ptr> errors(threads);
+     std::vector<Stats> stats(threads);
+     std::vector<std::vector<BadRecord> > rejected(threads);
+     for (unsigned int t = 0; t != threads; t++)
+         workers.emplace_back([this, t, &bounds, &chunks, &records, &columns, &errors, &stats,
+                               &rejected]() {
+             try
+             {
+                 records[t] = parseRange(_data, bounds[t], bounds[t + 1], chunks[t], columns[t],
+                                         _arenas.empty() ? nullptr : _arenas[t].get(),
+                                         _options.stats ? &stats[t] : nullptr,
+                                         _options.lenient ? &rejected[t] : nullptr);
+             }
+             catch (...)
+             {
+                 errors[t] = std::current_exception();
+             }
+         });
+     for (auto it = workers.begin(); it != workers.end(); it++)
+         it->join();
+
+     std::size_t total = 0;
+     for (unsigned int t = 0; t != threads; t++)
+         total += chunks[t].size();
+     _content.reserve(total);
+     for (unsigned int t = 0; t != threads; t++)
+         _content.insert(_content.end(), chunks[t].begin(), chunks[t].end());
+     for (unsigned int t = 0; t != threads; t++)
+         for (unsigned int i = 0; i != _columns.size(); i++)
+             _columns[i].append(columns[t][i]);
+     for (unsigned int t = 0; t != threads; t++)
+         addStats(_stats, stats[t]);
+     for (unsigned int t = 0; t != threads; t++)
+         _badRecords.insert(_badRecords.end(), rejected[t].begin(), rejected[t].end());
+
+     for (unsigned int t = 0; t != threads; t++)
+         if (errors[t])
+             std::rethrow_exception(errors[t]);
+     return std::accumulate(records.begin(), records.end(), std::size_t(0));
+  }
+
+  /*
+  ** Builds every row still missing in columnar or lazy mode. Editing
+  ** moves the table over to rows, after which the columns only back the
+  ** values of those rows and no longer follow the table.
+  */
+  void Parser::materialize(void)
+  {
+      if (_lazyRows)
+      {
+          for (unsigned int i = 0; i != _content.size(); i++)
+              getRow(i);
+          _lazyRows = false;
+          return;
+      }
+      if (_columns.empty() || _columnsStale)
+          return;
+      for (unsigned int i = 0; i != _content.size(); i++)
+          getRow(i);
+      _columnsStale = true;
+  }
+
+  /*
+  ** Moves the rows off the memory mapping onto an owned copy of the
+  ** input, so the file can be rewritten while the parser is alive.
+  */
+  void Parser::detach(void) const
+  {
+      if (!_mapping.isOpen())
+          return;
+
+      _buffer.assign(_data.data(), _data.size());
+      for (auto it = _content.begin(); it != _content.end(); it++)
+          if (*it != nullptr)
+              (*it)->rebase(_data.data(), _data.size(), _buffer.data());
+      _data = _buffer;
+      _mapping.close();
+  }
+
+  Row &Parser::getRow(unsigned int rowPosition) const
+  {
+      if (rowPosition >= rowCount())
+          throw Error("can't return this row (doesn't exist)");
+
+      if (!_live.empty())
+      {
+          std::size_t offset;
+          std::size_t slot = locate(rowPosition, offset);
+          if (slot % 2 == 0)
+              return *_gaps[slot / 2][offset];
+          return *_content[slot / 2];
+      }
+
+      Row *&row = _content[rowPosition];
+      if (row == nullptr && _lazyRows)
+          row = buildRow(rowPosition);
+      else if (row == nullptr)
+      {
+          row = newRow(_arenas.empty() ? nullptr : _arenas[0].get());
+          row->_values.reserve(_header._slots.empty() ? _columns.size() : _header._kept);
+          for (unsigned int i = 0; i != _columns.size(); i++)
+              if (isSelected(i))
+                  row->_values.push_back(_columns[i][rowPosition]);
+      }
+      return *row;
+  }
+
+  Row &Parser::operator[](unsigned int rowPosition) const
+  {
+      return Parser::getRow(rowPosition);
+  }
+
+  unsigned int Parser::rowCount(void) const
+  {
+      return _live.empty() ? _content.size() : _rows;
+  }
+
+  unsigned int Parser::columnCount(void) const
+  {
+      return _header.size();
+  }
+
+  std::vector<std::string> Parser::getHeader(void) const
+  {
+      return _header.names();
+  }
+
+  const Header &Parser::header(void) const
+  {
+      return _header;
+  }
+
+  const Column &Parser::getColumn(unsigned int pos) const
+  {
+      if (!_options.columnar)
+        throw Error("can't return this column (parser is not columnar)");
+      if (_columnsStale)
+        throw Error("can't return this column (rows were edited)");
+      if (pos >= _columns.size())
+        throw Error("can't return this column (doesn't exist)");
+      if (!isSelected(pos))
+        throw Error("can't return this column (not selected)");
+      return _columns[pos];
+  }
+
+  /*
+  ** What parsing did so far, refreshes included; all zero unless
+  ** Options::stats is set.
+  */
+  Stats Parser::stats(void) const
+  {
+      Stats stats = _stats;
+
+      if (_options.stats)
+          for (auto it = _arenas.begin(); it != _arenas.end(); it++)
+              stats.allocations += (*it)->blockCount();
+      return stats;
+  }
+
+  /*
+  ** The records a lenient parser left out, refreshes included.
+  */
+  const std::vector<BadRecord> &Parser::badRecords(void) const
+  {
+      return _badRecords;
+  }
+
+  bool Parser::isSelected(unsigned int pos) const
+  {
+      return pos < _header.size() && (_selected.empty() || _selected[pos]);
+  }
+
+  const std::string Parser::getHeaderElement(unsigned int pos) const
+  {
+      if (pos >= _header.size())
+        throw Error("can't return this header (doesn't exist)");
+      return _header[pos];
+  }
+
+  /*
+  ** Edits are only recorded (see _gaps), so that a batch of them costs
+  ** O(log n) each; the table is rebuilt once, by compact(), when it is
+  ** next written, refreshed or scanned.
+  */
+  bool Parser::deleteRow(unsigned int pos)
+  {
+    if (pos < rowCount())
+    {
+      materialize();
+      if (_live.empty())
+        startEdits();
+      _dirtyFrom = std::min<std::size_t>(_dirtyFrom, pos);
+      if (_ends.size() > pos + 1)
+        _ends.resize(pos + 1);
+      for (auto it = _ranges.begin(); it != _ranges.end(); it++)
+        it->rows = std::min<std::size_t>(it->rows, pos / RANGE_BLOCK * RANGE_BLOCK);
+
+      std::size_t offset;
+      std::size_t slot = locate(pos, offset);
+      if (slot % 2 == 0)
+      {
+        std::vector<Row *> &gap = _gaps[slot / 2];
+        release(gap[offset]);
+        gap.erase(gap.begin() + offset);
+      }
+      else
+      {
+        release(_content[slot / 2]);
+        _content[slot / 2] = nullptr;
+      }
+      countLive(slot, -1);
+      _rows--;
+      return true;
+    }
+    return false;
+  }
+
+  bool Parser::addRow(unsigned int pos, const std::vector<std::string> &r)
+  {
+    Row *row = new Row(_header);
+
+    // as parsed rows do, holds the columns kept only
+    for (unsigned int i = 0; i != r.size(); i++)
+      if (!(i < _header._slots.size() && _header._slots[i] < 0))
+        row->push(r[i]);
+
+    if (pos <= rowCount())
+    {
+      materialize();
+      if (_live.empty())
+        startEdits();
+      _dirtyFrom = std::min<std::size_t>(_dirtyFrom, pos);
+      if (_ends.size() > pos + 1)
+        _ends.resize(pos + 1);
+      for (auto it = _ranges.begin(); it != _ranges.end(); it++)
+        it->rows = std::min<std::size_t>(it->rows, pos / RANGE_BLOCK * RANGE_BLOCK);
+
+      // in front of the row now at `pos`, or after the last one
+      std::size_t offset = 0;
+      std::size_t slot = 2 * _content.size();
+      if (pos < _rows)
+        slot = locate(pos, offset);
+      std::vector<Row *> &gap = _gaps[slot / 2];
+      if (slot % 2 != 0 || pos == _rows)
+        offset = gap.size();
+      slot -= slot % 2;
+      gap.insert(gap.begin() + offset, row);
+      countLive(slot, 1);
+      _rows++;
+      return true;
+    }
+    return false;
+  }
+
+  /*
+  ** Starts recording edits: every row slot of _live counts one row, and
+  ** every gap none.
+  */
+  void Parser::startEdits(void)
+  {
+      std::size_t slots = 2 * _content.size() + 1;
+
+      _live.assign(slots + 1, 0);
+      for (std::size_t i = 1; i <= slots; i++)
+      {
+          // _live[i] is slot i - 1
+          if (i % 2 == 0)
+              _live[i]++;
+          std::size_t parent = i + (i & (~i + 1));
+          if (parent <= slots)
+              _live[parent] += _live[i];
+      }
+      _rows = _content.size();
+  }
+
+  /*
+  ** Slot of _live holding the row at `row` while edits are pending, and
+  ** where that row is in its gap.
+  */
+  std::size_t Parser::locate(std::size_t row, std::size_t &offset) const
+  {
+      std::size_t index = 0;
+      std::size_t step = 1;
+
+      while (step * 2 < _live.size())
+          step *= 2;
+      for (; step != 0; step /= 2)
+          if (index + step < _live.size() && _live[index + step] <= row)
+          {
+              index += step;
+              row -= _live[index];
+          }
+      offset = row;
+      return index;
+  }
+
+  void Parser::countLive(std::size_t slot, int delta)
+  {
+      for (std::size_t i = slot + 1; i < _live.size(); i += i & (~i + 1))
+          _live[i] = static_cast<std::uint32_t>(_live[i] + delta);
+  }
+
+  /*
+  ** Applies the pending edits to _content in one pass.
+  */
+  void Parser::compact(void) const
+  {
+      if (_live.empty())
+          return;
+
+      std::vector<Row *> content;
+      auto gap = _gaps.begin();
+      content.reserve(_rows);
+      for (std::size_t i = 0; i <= _content.size(); i++)
+      {
+          if (gap != _gaps.end() && gap->first == i)
+          {
+              content.insert(content.end(), gap->second.begin(), gap->second.end());
+              gap++;
+          }
+          if (i != _content.size() && _content[i] != nullptr)
+              content.push_back(_content[i]);
+      }
+      _content.swap(content);
+      _gaps.clear();
+      _live.clear();
+  }
+
+  /*
+  ** Told by Row::set() that a row referring to _header changed; it may
+  ** be a copy rather than one of the table's. A columnar table moves
+  ** over to rows, as on any other edit, for the columns don't see it.
+  */
+  void Parser::edited(const Row &row)
+  {
+      if (_options.columnar && !_columnsStale
+          && std::find(_content.begin(), _content.end(), &row) != _content.end())
+          materialize();
+
+      // with more rows edited than there are blocks, all are worked out again
+      if (_ranges.empty())
+          return;
+      _edited.push_back(&row);
+      if (_edited.size() > _content.size() / RANGE_BLOCK)
+      {
+          _ranges.clear();
+          _edited.clear();
+      }
+  }
+
+  /*
+  ** Writes the table back to its file through a temporary file. When
+  ** the file still holds the rows before the first edited one as they
+  ** are, their bytes are copied over as they are and only the rows from
+  ** there on are written again; with Options::syncInPlace those rows are
+  ** written over the file itself instead. A parser keeping only some
+  ** columns throws, as it would write the others back empty.
+  */
+  void Parser::sync(void) const
+  {
+    if (_type == DataType::eFILE || _type == DataType::eMAPPED)
+    {
+      if (_compressed)
+        throw Error(std::string("can't write compressed file ").append(_file));
+      if (std::find(_selected.begin(), _selected.end(), false) != _selected.end())
+        throw Error(std::string("can't write file with columns left out ").append(_file));
+      compact();
+      detach();
+
+      std::size_t first = std::min(_dirtyFrom, _content.size());
+      for (std::size_t i = 0; i < first; i++)
+        if (_content[i] != nullptr && _content[i]->_dirty)
+          first = i;
+      std::uint64_t offset = cleanEnd(first);
+      if (first == _content.size() && offset == _parsedEnd)
+        return;
+
+      std::unique_ptr<Writer> writer;
+      std::vector<std::uint64_t> ends;
+      if (offset == static_cast<std::uint64_t>(-1))
+      {
+        writer.reset(new Writer(_file, _sep));
+        writer->write(_header.names());
+        ends.push_back(writer->size());
+        first = 0;
+      }
+      else
+      {
+        writer.reset(new Writer(_file, _sep, 1 << 20, offset, _options.syncInPlace));
+        ends.assign(_ends.begin(), _ends.begin() + first + 1);
+      }
+
+      for (std::size_t row = first; row != _content.size(); row++)
+      {
+        writer->write(getRow(static_cast<unsigned int>(row)));
+        ends.push_back(writer->size());
+      }
+      writer->commit();
+
+      // the records set aside past the rows kept are now gone
+      while (!_badRecords.empty() && (offset == static_cast<std::uint64_t>(-1)
+                                      || _badRecords.back().offset >= offset))
+        _badRecords.pop_back();
+      for (std::size_t row = first; row != _content.size(); row++)
+        _content[row]->_dirty = false;
+      _ends.swap(ends);
+      _dirtyFrom = static_cast<std::size_t>(-1);
+      _mirrorsFile = false;
+      trackTail(writer->size());
+
+      // rows not built yet still start where _starts says in the input,
+      // but the file no longer matches it
+      if (_indexSaved)
+      {
+        std::error_code error;
+        std::filesystem::remove(_file + ".idx", error);
+        _indexSaved = false;
+      }
+    }
+  }
+
+  /*
+  ** Where the header and the first `rows` rows end in the file, if the
+  ** file still holds them as they are; -1 otherwise. The offsets are
+  ** known after a sync(), and are otherwise found from where the rows
+  ** point into the input while it mirrors the file.
+  */
+  std::uint64_t Parser::cleanEnd(std::size_t rows) const
+  {
+      const std::uint64_t unknown = static_cast<std::uint64_t>(-1);
+      std::error_code error;
+      std::string tail;
+
+      std::uint64_t size = std::filesystem::file_size(_file, error);
+      if (error || size != _parsedEnd || !readTail(_file, _parsedEnd, tail)
+          || lastLineHash(tail) != _tailHash)
+        return unknown;
+
+      if (_mirrorsFile && _ends.empty() && _contentStart != 0
+          && _data[_contentStart - 1] == '\n')
+        _ends.push_back(_contentStart);
+      std::vector<std::string_view> fields;
+      while (_mirrorsFile && !_ends.empty() && _ends.size() <= rows)
+      {
+        const Row *row = _content[_ends.size() - 1];
+        std::size_t end;
+        if (row == nullptr && _lazyRows)
+          // a row never built is still as it was read
+          end = _split(_data, static_cast<std::size_t>(_starts[_ends.size() - 1]), _sep, fields);
+        else if (row == nullptr || row->_values.empty() || row->_dirty)
+          break;
+        else
+        {
+          // the record ends at the newline right after its last value
+          std::string_view last = row->_values.back();
+          if (last.data() < _data.data() || last.data() + last.size() > _data.data() + _data.size())
+            break;
+          end = last.data() + last.size() - _data.data();
+        }
+        if (end != _data.size() && _data[end] == '\r')
+          end++;
+        if (end == _data.size() || _data[end] != '\n')
+          break;
+        _ends.push_back(end + 1);
+      }
+      return rows < _ends.size() ? _ends[rows] : unknown;
+  }
+
+  /*
+  ** Parses the complete records appended to the file since it was last
+  ** read, and adds them after the last row; returns how many there are.
+  ** Only the new bytes are read. A record still being written is left
+  ** for the next call. Throws if the file was rewritten rather than
+  ** appended to, in which case it has to be parsed again.
+  */
+  unsigned int Parser::refresh(void)
+  {
+      if (_type == ePURE)
+          throw Error("can't refresh pure content");
+      if (_compressed)
+          throw Error(std::string("can't refresh compressed file ").append(_file));
+
+      std::error_code error;
+      std::uint64_t size = std::filesystem::file_size(_file, error);
+      if (error)
+          throw Error(std::string("Failed to open ").append(_file));
+      compact();
+
+      std::string tail;
+      if (size < _parsedEnd || !readTail(_file, _parsedEnd, tail)
+          || lastLineHash(tail) != _tailHash)
+          throw Error(std::string("file was rewritten, parse it again : ").append(_file));
+      if (size == _parsedEnd)
+          return 0;
+      // the last record read had no line terminator and may have grown
+      if (!tail.empty() && tail.back() != '\n')
+          throw Error(std::string("file was rewritten, parse it again : ").append(_file));
+
+      Clock::time_point start = Clock::now();
+      std::string bytes(static_cast<std::size_t>(size - _parsedEnd), '\0');
+      std::ifstream in(_file.c_str(), std::ios::in | std::ios::binary);
+      in.seekg(static_cast<std::streamoff>(_parsedEnd));
+      in.read(&bytes[0], bytes.size());
+      if (!in)
+          throw Error(std::string("Failed to read ").append(_file));
+      bytes.resize(completeLength(bytes, _options.quote, _options.escape));
+      if (_options.stats)
+      {
+          _stats.readNs += nanoseconds(start);
+          _stats.bytes += bytes.size();
+      }
+      if (bytes.empty())
+          return 0;
+
+      // parsed aside, so a corrupted record leaves the table as it was
+      std::vector<Row *> rows;
+      std::vector<Column> columns;
+      if (!_columnsStale && !_columns.empty())
+          makeColumns(columns);
+      std::vector<BadRecord> rejected;
+      std::uint64_t lines = _lines;
+      std::size_t records;
+      _appended.push_back(std::string());
+      _appended.back().swap(bytes);
+      try
+      {
+          records = parseRange(_appended.back(), 0, _appended.back().size(), rows, columns,
+                               _arenas.empty() ? nullptr : _arenas[0].get(),
+                               _options.stats ? &_stats : nullptr,
+                               _options.lenient ? &rejected : nullptr);
+          if (!rejected.empty() && lines == static_cast<std::uint64_t>(-1)
+              && !countLines(_file, _parsedEnd, lines))
+              throw Error(std::string("Failed to read ").append(_file));
+      }
+      catch (...)
+      {
+          for (auto it = rows.begin(); it != rows.end(); it++)
+              release(*it);
+          _appended.pop_back();
+          throw;
+      }
+
+      for (auto it = rejected.begin(); it != rejected.end(); it++)
+          it->offset += _parsedEnd;
+      if (!rejected.empty())
+          numberLines(_appended.back(), _parsedEnd, lines + 1, rejected.begin(), rejected.end());
+      _badRecords.insert(_badRecords.end(), rejected.begin(), rejected.end());
+      if (lines != static_cast<std::uint64_t>(-1))
+          lines += std::count(_appended.back().begin(), _appended.back().end(), '\n');
+
+      _parsedEnd += _appended.back().size();
+      if (_options.columnar && !_columnsStale)
+      {
+          // the columns keep their own copy of the values; the rows
+          // built so far follow a column whose bytes moved
+          for (unsigned int i = 0; i != _columns.size(); i++)
+          {
+              const char *from = _columns[i]._bytes.data();
+              std::size_t length = _columns[i]._bytes.size();
+              _columns[i].append(columns[i]);
+              if (_columns[i]._bytes.data() == from)
+                  continue;
+              for (auto it = _content.begin(); it != _content.end(); it++)
+                  if (*it != nullptr)
+                      (*it)->rebase(from, length, _columns[i]._bytes.data());
+          }
+          _content.resize(_content.size() + records, nullptr);
+          _appended.pop_back();
+      }
+      else
+          _content.insert(_content.end(), rows.begin(), rows.end());
+      trackTail(_parsedEnd);
+      _lines = lines;
+
+      // the index follows the file as long as it holds every record
+      if (_indexSaved && rejected.empty())
+      {
+          std::size_t from = _starts.size();
+          indexRange(_appended.back(), 0, _appended.back().size(),
+                     _parsedEnd - _appended.back().size(), nullptr, nullptr);
+          appendIndex(from);
+      }
+      else if (_indexSaved)
+      {
+          std::error_code error;
+          std::filesystem::remove(_file + ".idx", error);
+          _indexSaved = false;
+      }
+      return static_cast<unsigned int>(records);
+  }
+
+  /*
+  ** Remembers that the first `end` bytes of the file have been read,
+  ** with a hash of their last line for refresh() to check.
+  */
+  void Parser::trackTail(std::uint64_t end) const
+  {
+      std::string tail;
+
+      _parsedEnd = end;
+      _tailHash = readTail(_file, end, tail) ? lastLineHash(tail) : 0;
+      _lines = static_cast<std::uint64_t>(-1);
+  }
+
+  const std::string &Parser::getFileName(void) const
+  {
+      return _file;
+  }
+
+  /*
+  ** FILES
+  */
+
+  namespace
+  {
+    bool matches(const char *pattern, const char *name)
+    {
+        if (*pattern == '*')
+            return matches(pattern + 1, name) || (*name != '\0' && matches(pattern, name + 1));
+        if (*name == '\0')
+            return *pattern == '\0';
+        return (*pattern == '?' || *pattern == *name) && matches(pattern + 1, name + 1);
+    }
+
+    // the files a parser or writer keeps next to a CSV file
+    bool sidecar(const std::string &name)
+    {
+        const char *suffixes[] = { ".snap", ".idx", ".tmp" };
+
+        for (const char *suffix : suffixes)
+        {
+            std::size_t length = std::strlen(suffix);
+            if (name.size() >= length && name.compare(name.size() - length, length, suffix) == 0)
+                return true;
+        }
+        return false;
+    }
+  }
+
+  std::vector<std::string> glob(const std::string &pattern)
+  {
+      std::size_t slash = pattern.find_last_of("/\\");
+      std::string directory = slash == std::string::npos ? std::string() : pattern.substr(0, slash + 1);
+      std::string name = pattern.substr(directory.size());
+      std::vector<std::string> files;
+
+      if (name.find_first_of("*?") == std::string::npos)
+          return std::vector<std::string>(1, pattern);
+
+      std::error_code error;
+      std::filesystem::directory_iterator it(directory.empty() ? "." : directory, error);
+      for (; !error && it != std::filesystem::directory_iterator(); it.increment(error))
+      {
+          std::string entry = it->path().filename().string();
+          if (it->is_regular_file(error) && !sidecar(entry) && matches(name.c_str(), entry.c_str()))
+              files.push_back(directory + entry);
+      }
+      if (files.empty())
+          throw Error(std::string("no file matches : ").append(pattern));
+      std::sort(files.begin(), files.end());
+      return files;
+  }
+
+  std::vector<std::unique_ptr<Parser> > parseFiles(const std::vector<std::string> &files,
+                                                   const DataType &type, char sep,
+                                                   const Options &options)
+  {
+      std::vector<std::unique_ptr<Parser> > parsers(files.size());
+      std::vector<std::exception_ptr> errors(files.size());
+      std::atomic<std::size_t> next(0);
+      std::vector<std::thread> workers;
+
+      // each thread takes the next file not parsed yet
+      unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+      for (std::size_t t = 0; t != std::min<std::size_t>(threads, files.size()); t++)
+          workers.emplace_back([&]() {
+              for (std::size_t i = next++; i < files.size(); i = next++)
+              {
+                  try
+                  {
+                      parsers[i].reset(new Parser(files[i], type, sep, options));
+                  }
+                  catch (const std::exception &e)
+                  {
+                      // name the file, which the parser's own errors may not
+                      std::size_t skip = std::strncmp(e.what(), "CSVparser : ", 12) == 0 ? 12 : 0;
+                      std::string reason = std::string("failed to parse ").append(files[i]);
+                      reason.append(" : ").append(e.what() + skip);
+                      errors[i] = std::make_exception_ptr(Error(reason));
+                  }
+                  catch (...)
+                  {
+                      errors[i] = std::current_exception();
+                  }
+              }
+          });
+      for (auto it = workers.begin(); it != workers.end(); it++)
+          it->join();
+
+      for (std::size_t i = 0; i != files.size(); i++)
+          if (errors[i])
+              std::rethrow_exception(errors[i]);
+      return parsers;
+  }
+
+  /*
+  ** ARENA
+  */
+
+  Arena::Arena(std::size_t blockSize)
+    : _blockSize(blockSize), _cursor(nullptr), _left(0) {}
+
+  Arena::~Arena(void) {}
+
+  void *Arena::allocate(std::size_t size, std::size_t align)
+  {
+      std::size_t padding = (align - reinterpret_cast<std::uintptr_t>(_cursor) % align) % align;
+
+      if (padding + size > _left)
+      {
+          // oversized requests get a block of their own
+          std::size_t length = std::max(_blockSize, size + align);
+          _blocks.emplace_back(new char[length]);
+          _cursor = _blocks.back().get();
+          _left = length;
+          padding = (align - reinterpret_cast<std::uintptr_t>(_cursor) % align) % align;
+      }
+
+      char *result = _cursor + padding;
+      _cursor += padding + size;
+      _left -= padding + size;
+      return result;
+  }
+
+  std::size_t Arena::blockCount(void) const
+  {
+      return _blocks.size();
+  }
+
+  /*
+  ** HEADER
+  */
+
+  Header::Header(void) : _kept(0), _owner(nullptr) {}
+
+  Header::Header(const std::vector<std::string> &names)
+      : _names(names), _kept(names.size()), _owner(nullptr)
+  {
+    _index.reserve(_names.size());
+    // on duplicate names the first column wins, as a linear search would
+    for (unsigned int i = 0; i != _names.size(); i++)
+      _index.emplace(_names[i], i);
+    // then names trimmed, which never hide a name as it is
+    for (unsigned int i = 0; i != _names.size(); i++)
+    {
+      std::string_view trimmed = trim(_names[i]);
+      if (trimmed.size() != _names[i].size())
+        _index.emplace(std::string(trimmed), i);
+    }
+  }
+
+  Header::Header(const Header &other)
+      : _names(other._names), _index(other._index), _slots(other._slots),
+        _kept(other._kept), _owner(nullptr) {}
+
+  // the header keeps belonging to its parser
+  Header &Header::operator=(const Header &other)
+  {
+    _names = other._names;
+    _index = other._index;
+    _slots = other._slots;
+    _kept = other._kept;
+    return *this;
+  }
+
+  /*
+  ** Numbers the columns kept, `kept` having one flag per column; with
+  ** every column kept (or none given) rows hold them all.
+  */
+  void Header::select(const std::vector<bool> &kept)
+  {
+    _slots.clear();
+    _kept = _names.size();
+    if (std::find(kept.begin(), kept.end(), false) == kept.end())
+      return;
+
+    _kept = 0;
+    _slots.resize(_names.size(), -1);
+    for (unsigned int i = 0; i != kept.size() && i != _slots.size(); i++)
+      if (kept[i])
+        _slots[i] = static_cast<int>(_kept++);
+  }
+
+  int Header::slot(unsigned int pos) const
+  {
+    return _slots.empty() ? static_cast<int>(pos) : _slots[pos];
+  }
+
+  unsigned int Header::size(void) const
+  {
+    return _names.size();
+  }
+
+  int Header::find(const std::string &name) const
+  {
+    auto it = _index.find(name);
+    if (it == _index.end())
+    {
+      std::string_view trimmed = trim(name);
+      if (trimmed.size() != name.size())
+        it = _index.find(std::string(trimmed));
+    }
+    return (it == _index.end()) ? -1 : static_cast<int>(it->second);
+  }
+
+  int Header::find(const std::vector<std::string> &aliases) const
+  {
+    for (auto it = aliases.begin(); it != aliases.end(); it++)
+    {
+      int pos = find(*it);
+      if (pos >= 0)
+        return pos;
+    }
+    return -1;
+  }
+
+  const std::vector<std::string> &Header::names(void) const
+  {
+    return _names;
+  }
+
+  const std::string &Header::operator[](unsigned int pos) const
+  {
+    return _names[pos];
+  }
+
+  /*
+  ** ROW
+  */
+
+  Row::Row(const std::vector<std::string> &header)
+      : _header(nullptr), _owned(new Owned()), _dirty(false)
+  {
+    _owned->header = std::make_shared<Header>(header);
+    _header = _owned->header.get();
+  }
+
+  Row::Row(const Header &header)
+      : _header(&header), _dirty(false) {}
+
+  Row::Row(const Header &header, Arena *arena)
+      : _header(&header), _values(ArenaAllocator<std::string_view>(arena)), _dirty(false) {}
+
+  Row::Row(const Row &other)
+      : _header(other._header), _values(other._values),
+        _owned(other._owned ? new Owned(*other._owned) : nullptr), _dirty(other._dirty)
+  {
+    relink(other);
+  }
+
+  /*
+  ** A row from an arena moves its values to the heap, as the new row
+  ** may outlive the parser; the values it owns stay where they are, so
+  ** views into them stay valid.
+  */
+  Row::Row(Row &&other) noexcept
+      : _header(other._header),
+        _values(std::move(other._values), ArenaAllocator<std::string_view>()),
+        _owned(std::move(other._owned)), _dirty(other._dirty) {}
+
+  Row &Row::operator=(const Row &other)
+  {
+    if (this != &other)
+    {
+        _header = other._header;
+        _values = other._values;
+        _owned.reset(other._owned ? new Owned(*other._owned) : nullptr);
+        _dirty = other._dirty;
+        relink(other);
+    }
+    return *this;
+  }
+
+  Row &Row::operator=(Row &&other) noexcept
+  {
+    _header = other._header;
+    _values = std::move(other._values);
+    _owned = std::move(other._owned);
+    _dirty = other._dirty;
+    return *this;
+  }
+
+  Row::~Row(void) {}
+
+  /*
+  ** A row of a parser leaving columns out has every column, those read
+  ** back empty.
+  */
+  unsigned int Row::size(void) const
+  {
+    return _header->_slots.empty() ? _values.size() : _header->size();
+  }
+
+  void Row::push(const std::string &value)
+  {
+    _values.push_back(std::string_view());
+    own(_values.size() - 1, value);
+  }
+
+  bool Row::set(const std::string &key, const std::string &value)
+  {
+    int pos = _header->find(key);
+
+    if (pos >= 0)
+      pos = _header->slot(pos);
+    if (pos < 0 || static_cast<unsigned int>(pos) >= _values.size())
+      return false;
+    own(pos, value);
+    if (_header->_owner != nullptr)
+      _header->_owner->edited(*this);
+    return true;
+  }
+
+  /*
+  ** Stores `value` in the slot of position `pos`, which the next value
+  ** given for that position overwrites, and points the row at it.
+  */
+  void Row::own(unsigned int pos, const std::string &value)
+  {
+    if (!_owned)
+      _owned.reset(new Owned());
+
+    std::vector<std::string> &slots = _owned->values;
+    if (pos >= slots.capacity())
+    {
+        // growing moves the strings, and with them short ones' bytes
+        std::vector<bool> owned(slots.size());
+        for (unsigned int i = 0; i != slots.size(); i++)
+            owned[i] = owns(i);
+        slots.reserve(std::max<std::size_t>(std::max<std::size_t>(pos + 1, _values.size()),
+                                            2 * slots.capacity()));
+        for (unsigned int i = 0; i != owned.size(); i++)
+            if (owned[i])
+                _values[i] = slots[i];
+    }
+    if (pos >= slots.size())
+        slots.resize(pos + 1);
+    slots[pos] = value;
+    _values[pos] = slots[pos];
+    _dirty = true;
+  }
+
+  /*
+  ** Whether the value at `pos` is the one the row owns for it.
+  */
+  bool Row::owns(unsigned int pos) const
+  {
+    return _owned && pos < _owned->values.size() && pos < _values.size()
+        && _values[pos].data() == _owned->values[pos].data();
+  }
+
+  void Row::clear(void)
+  {
+    _values.clear();
+    if (_owned)
+      _owned->values.clear();
+  }
+
+  void Row::rebase(const char *from, std::size_t length, const char *to)
+  {
+    for (auto it = _values.begin(); it != _values.end(); it++)
+    {
+        if (it->data() >= from && it->data() < from + length)
+          *it = std::string_view(to + (it->data() - from), it->size());
+    }
+  }
+
+  /*
+  ** Points the values that were owned by the row this one was copied
+  ** from at this row's copies of them.
+  */
+  void Row::relink(const Row &from)
+  {
+    for (unsigned int i = 0; i != _values.size(); i++)
+        if (from.owns(i))
+          _values[i] = _owned->values[i];
+  }
+
+  /*
+  ** Value at a position below size(), empty for a column left out.
+  */
+  std::string_view Row::value(unsigned int pos) const
+  {
+    int slot = _header->slot(pos);
+
+    return slot < 0 ? std::string_view() : _values[slot];
+  }
+
+  Cents Row::getCents(unsigned int pos) const
+  {
+    Cents amount;
+
+    if (pos >= size())
+      throw Error("can't return this value (doesn't exist)");
+    parseCurrency(value(pos), amount);
+    return amount;
+  }
+
+  const std::string Row::operator[](unsigned int valuePosition) const
+  {
+       return std::string(field(valuePosition));
+  }
+
+  const std::string Row::operator[](const std::string &key) const
+  {
+      return std::string(field(key));
+  }
+
+  std::string_view Row::field(unsigned int valuePosition) const
+  {
+      if (valuePosition < size())
+          return value(valuePosition);
+      throw Error("can't return this value (doesn't exist)");
+  }
+
+  std::string_view Row::field(const std::string &key) const
+  {
+      int pos = _header->find(key);
+
+      if (pos >= 0 && static_cast<unsigned int>(pos) < size())
+          return value(pos);
+      throw Error("can't return this value (doesn't exist)");
+  }
+
+  const Header &Row::header(void) const
+  {
+      return *_header;
+  }
+
+  std::ostream &operator<<(std::ostream &os, const Row &row)
+  {
+      for (unsigned int i = 0; i != row.size(); i++)
+          os << row.value(i) << " | ";
+
+      return os;
+  }
+
+  std::ofstream &operator<<(std::ofstream &os, const Row &row)
+  {
+    for (unsigned int i = 0; i != row.size(); i++)
+    {
+        os << row.value(i);
+        if (i < row.size() - 1)
+          os << ",";
+    }
+    return os;
+  }
+
+  /*
+  ** COLUMN
+  */
+
+  Column::Column(void)
+    : _offsets(1, 0), _encoded(false) {}
+
+  Column::Column(bool encoded)
+    : _offsets(1, 0), _encoded(encoded) {}
+
+  // the index points into _values, so a copy needs its own
+  Column::Column(const Column &other)
+    : _bytes(other._bytes), _offsets(other._offsets), _encoded(other._encoded),
+      _codes(other._codes), _values(other._values)
+  {
+    reindex();
+  }
+
+  Column &Column::operator=(const Column &other)
+  {
+    if (this != &other)
+    {
+      _bytes = other._bytes;
+      _offsets = other._offsets;
+      _encoded = other._encoded;
+      _codes = other._codes;
+      _values = other._values;
+      reindex();
+    }
+    return *this;
+  }
+
+  unsigned int Column::size(void) const
+  {
+    if (_encoded)
+      return _codes.size();
+    return _offsets.size() - 1;
+  }
+
+  std::string_view Column::operator[](unsigned int row) const
+  {
+    if (row >= size())
+      throw Error("can't return this value (doesn't exist)");
+    if (_encoded)
+      return _values[_codes[row]];
+    return std::string_view(_bytes.data() + _offsets[row], _offsets[row + 1] - _offsets[row]);
+  }
+
+  bool Column::encoded(void) const
+  {
+    return _encoded;
+  }
+
+  unsigned int Column::code(unsigned int row) const
+  {
+    if (!_encoded)
+      throw Error("can't return this code (column is not encoded)");
+    if (row >= size())
+      throw Error("can't return this code (doesn't exist)");
+    return _codes[row];
+  }
+
+  int Column::find(std::string_view value) const
+  {
+    if (!_encoded)
+      throw Error("can't find this value (column is not encoded)");
+    auto it = _index.find(value);
+    return it == _index.end() ? -1 : static_cast<int>(it->second);
+  }
+
+  unsigned int Column::distinct(void) const
+  {
+    return _values.size();
+  }
+
+  void Column::push(std::string_view value)
+  {
+    if (_encoded)
+    {
+      _codes.push_back(intern(value));
+      return;
+    }
+    _bytes.append(value.data(), value.size());
+    _offsets.push_back(_bytes.size());
+  }
+
+  /*
+  ** Code of a value, adding it to the dictionary if it is new.
+  */
+  unsigned int Column::intern(std::string_view value)
+  {
+    auto it = _index.find(value);
+    if (it != _index.end())
+      return it->second;
+    _values.emplace_back(value);
+    _index.emplace(_values.back(), _values.size() - 1);
+    return _values.size() - 1;
+  }
+
+  void Column::reindex(void)
+  {
+    _index.clear();
+    for (unsigned int i = 0; i != _values.size(); i++)
+      _index.emplace(_values[i], i);
+  }
+
+  void Column::append(const Column &other)
+  {
+    if (_encoded)
+    {
+      // the other column numbered its values on its own
+      std::vector<unsigned int> codes(other._values.size());
+      for (unsigned int i = 0; i != codes.size(); i++)
+        codes[i] = intern(other._values[i]);
+      _codes.reserve(_codes.size() + other._codes.size());
+      for (auto it = other._codes.begin(); it != other._codes.end(); it++)
+        _codes.push_back(codes[*it]);
+      return;
+    }
+
+    std::size_t base = _bytes.size();
+
+    _bytes.append(other._bytes);
+    _offsets.reserve(_offsets.size() + other.size());
+    for (auto it = other._offsets.begin() + 1; it != other._offsets.end(); it++)
+      _offsets.push_back(base + *it);
+  }
+
+  /*
+  ** READER
+  */
+
+  Reader::Reader(const std::string &file, char sep, std::size_t bufferSize, bool readAhead)
+    : Reader(file, sep, bufferSize, readAhead, '"', '"', false) {}
+
+  Reader::Reader(const std::string &file, char sep, std::size_t bufferSize, bool readAhead,
+                 char quote, char escape, bool trim, bool lenient, Stats *stats,
+                 std::vector<BadRecord> *rejected)
+    : _file(file), _sep(sep), _quote(quote), _split(tokenizerFor(sep, quote, escape, trim)),
+      _buffer(bufferSize > 0 ? bufferSize : 1),
+      _begin(0), _end(0), _eof(false), _lenient(lenient), _stats(stats), _rejected(rejected),
+      _offset(0), _line(0), _aheadSize(0), _aheadEof(false),
+      _ready(false), _stop(false)
   {
-      std::string line;
-      if (type == eFILE)
+      _source = Source::open(_file);
+      if (readAhead)
       {
-        _file = data;
-        std::ifstream ifile(_file.c_str());
-        if (ifile.is_open())
-        {
-            while (ifile.good())
-            {
-                getline(ifile, line);
-                if (line != "")
-                    _originalFile.push_back(line);
-            }
-            ifile.close();
+          _ahead.resize(_buffer.size());
+          _loader = std::thread(&Reader::readBlocks, this);
+      }
 
-            if (_originalFile.size() == 0)
+      // the destructor won't stop the loader if the header is missing
+      try
+      {
+          Row header(_header);
+          std::vector<std::string> names;
+          if (!next(header))
               throw Error(std::string("No Data in ").append(_file));
-            
-            parseHeader();
-            parseContent();
-        }
-        else
-            throw Error(std::string("Failed to open ").append(_file));
+          for (unsigned int i = 0; i != header.size(); i++)
+              names.push_back(header[i]);
+          _header = Header(names);
+          _current.reset(new Row(_header));
       }
-      else
+      catch (...)
       {
-        std::istringstream stream(data);
-        while (std::getline(stream, line))
-          if (line != "")
-            _originalFile.push_back(line);
-        if (_originalFile.size() == 0)
-          throw Error(std::string("No Data in pure content"));
+          stopReading();
+          throw;
+      }
+  }
+
+  Reader::~Reader(void)
+  {
+      stopReading();
+  }
+
+  /*
+  ** Body of the read-ahead thread: reads a block into _ahead whenever
+  ** the previous one has been taken by fill().
+  */
+  void Reader::readBlocks(void)
+  {
+      std::unique_lock<std::mutex> lock(_lock);
 
-        parseHeader();
-        parseContent();
+      while (!_aheadEof)
+      {
+          _signal.wait(lock, [this]() { return _stop || !_ready; });
+          if (_stop)
+              return;
+
+          lock.unlock();
+          std::size_t count = 0;
+          std::exception_ptr error;
+          try
+          {
+              count = _source->read(_ahead.data(), _ahead.size());
+          }
+          catch (...)
+          {
+              error = std::current_exception();
+          }
+          lock.lock();
+
+          _aheadSize = count;
+          _aheadEof = count < _ahead.size() || error;
+          _aheadError = error;
+          _ready = true;
+          _signal.notify_all();
       }
   }
 
-  Parser::~Parser(void)
+  void Reader::stopReading(void)
   {
-     std::vector<Row *>::iterator it;
+      if (!_loader.joinable())
+          return;
+      {
+          std::lock_guard<std::mutex> lock(_lock);
+          _stop = true;
+      }
+      _signal.notify_all();
+      _loader.join();
+  }
 
-     for (it = _content.begin(); it != _content.end(); it++)
-          delete *it;
+  /*
+  ** Makes room after the unread bytes and reads more of the file, or
+  ** takes the block read ahead. The buffer only grows when a single
+  ** record does not fit in it, or to make room for that block.
+  */
+  bool Reader::fill(void)
+  {
+      if (_eof)
+          return false;
+
+      if (_begin != 0)
+      {
+          std::copy(_buffer.begin() + _begin, _buffer.begin() + _end, _buffer.begin());
+          _end -= _begin;
+          _offset += _begin;
+          _begin = 0;
+      }
+      Clock::time_point start;
+      if (_stats != nullptr)
+          start = Clock::now();
+      if (_loader.joinable())
+      {
+          // take the block read ahead, and have the next one read
+          std::unique_lock<std::mutex> lock(_lock);
+          _signal.wait(lock, [this]() { return _ready; });
+          if (_stats != nullptr)
+          {
+              _stats->readNs += nanoseconds(start);
+              _stats->bytes += _aheadSize;
+          }
+          if (_aheadError)
+              std::rethrow_exception(_aheadError);
+
+          if (_buffer.size() - _end < _aheadSize)
+              _buffer.resize(_end + _aheadSize);
+          std::copy(_ahead.begin(), _ahead.begin() + _aheadSize, _buffer.begin() + _end);
+          _end += _aheadSize;
+          _eof = _aheadEof;
+          _ready = false;
+          _signal.notify_all();
+          return true;
+      }
+
+      if (_end == _buffer.size())
+          _buffer.resize(_buffer.size() * 2);
+
+      std::size_t wanted = _buffer.size() - _end;
+      std::size_t count = _source->read(&_buffer[_end], wanted);
+      if (_stats != nullptr)
+      {
+          _stats->readNs += nanoseconds(start);
+          _stats->bytes += count;
+      }
+      _end += count;
+      if (count < wanted)
+          _eof = true;
+      return true;
   }
 
-  void Parser::parseHeader(void)
+  bool Reader::next(Row &row)
   {
-      std::stringstream ss(_originalFile[0]);
-      std::string item;
+      while (true)
+      {
+          std::string_view data(_buffer.data() + _begin, _end - _begin);
+          Clock::time_point start;
+          if (_stats != nullptr)
+              start = Clock::now();
+          std::size_t end = _split(data, 0, _sep, _fields);
+          if (_stats != nullptr)
+              _stats->tokenizeNs += nanoseconds(start);
+
+          // the record may continue past what has been read so far
+          if (end == data.size() && fill())
+              continue;
+          if (data.empty())
+              return false;
+
+          std::uint64_t offset = _offset + _begin;
+          std::uint64_t line = _line + 1;
+          end = nextRecord(data, end);
+          _begin += end;
+          if (_lenient)
+              _line += std::count(data.begin(), data.begin() + end, '\n');
+          if (_stats != nullptr)
+              countRecord(*_stats, _fields, _quote);
+          if (isBlank(_fields))
+              continue;
 
-      while (std::getline(ss, item, _sep))
-          _header.push_back(item);
+          // header is still being read while it is empty
+          if (_header.size() != 0 && _fields.size() != _header.size())
+          {
+              if (!_lenient)
+                  throw Error("corrupted data !");
+              if (_rejected != nullptr)
+                  _rejected->push_back(BadRecord{line, offset, std::string("expected ")
+                      .append(std::to_string(_header.size())).append(" fields, found ")
+                      .append(std::to_string(_fields.size()))});
+              continue;
+          }
+
+          row.clear();
+          row._values.assign(_fields.begin(), _fields.end());
+          return true;
+      }
   }
 
-  void Parser::parseContent(void)
+  unsigned int Reader::columnCount(void) const
   {
-     std::vector<std::string>::iterator it;
-     
-     it = _originalFile.begin();
-     it++; // skip header
+      return _header.size();
+  }
 
-     for (; it != _originalFile.end(); it++)
-     {
-         bool quoted = false;
-         int tokenStart = 0;
-         unsigned int i = 0;
+  std::vector<std::string> Reader::getHeader(void) const
+  {
+      return _header.names();
+  }
 
-         Row *row = new Row(_header);
+  const Header &Reader::header(void) const
+  {
+      return _header;
+  }
 
-         for (; i != it->length(); i++)
-         {
-              if (it->at(i) == '"')
-                  quoted = ((quoted) ? (false) : (true));
-              else if (it->at(i) == ',' && !quoted)
-              {
-                  row->push(it->substr(tokenStart, i - tokenStart));
-                  tokenStart = i + 1;
-              }
-         }
+  const std::string &Reader::getFileName(void) const
+  {
+      return _file;
+  }
 
-         //end
-         row->push(it->substr(tokenStart, it->length() - tokenStart));
+  Reader::iterator Reader::begin(void)
+  {
+      return iterator(next(*_current) ? this : nullptr);
+  }
 
-         // if value(s) missing
-         if (row->size() != _header.size())
-          throw Error("corrupted data !");
-          _content.push_back(row);
-     }
+  Reader::iterator Reader::end(void)
+  {
+      return iterator();
   }
 
-  Row &Parser::getRow(unsigned int rowPosition) const
+  Reader::iterator::iterator(Reader *reader)
+    : _reader(reader) {}
+
+  const Row &Reader::iterator::operator*(void) const
   {
-      if (rowPosition < _content.size())
-          return *(_content[rowPosition]);
-      throw Error("can't return this row (doesn't exist)");
+      return *_reader->_current;
   }
 
-  Row &Parser::operator[](unsigned int rowPosition) const
+  const Row *Reader::iterator::operator->(void) const
   {
-      return Parser::getRow(rowPosition);
+      return _reader->_current.get();
   }
 
-  unsigned int Parser::rowCount(void) const
+  Reader::iterator &Reader::iterator::operator++(void)
   {
-      return _content.size();
+      if (!_reader->next(*_reader->_current))
+          _reader = nullptr;
+      return *this;
   }
 
-  unsigned int Parser::columnCount(void) const
+  bool Reader::iterator::operator==(const iterator &other) const
   {
-      return _header.size();
+      return _reader == other._reader;
   }
 
-  std::vector<std::string> Parser::getHeader(void) const
+  bool Reader::iterator::operator!=(const iterator &other) const
   {
-      return _header;
+      return _reader != other._reader;
   }
 
-  const std::string Parser::getHeaderElement(unsigned int pos) const
+  std::size_t parse(const std::string &file, const std::function<void(RecordView)> &visitor,
+                    char sep, const Options &options, Stats *stats,
+                    std::vector<BadRecord> *rejected)
   {
-      if (pos >= _header.size())
-        throw Error("can't return this header (doesn't exist)");
-      return _header[pos];
+      Reader reader(file, sep, 1 << 16, options.readAhead, options.quote, options.escape,
+                    options.trim, options.lenient, stats, rejected);
+      Row &row = *reader._current;
+      std::size_t records = 0;
+
+      while (reader.next(row))
+      {
+          Clock::time_point start;
+          if (stats != nullptr)
+              start = Clock::now();
+          visitor(row);
+          if (stats != nullptr)
+              stats->buildNs += nanoseconds(start);
+          records++;
+      }
+      return records;
   }
 
-  bool Parser::deleteRow(unsigned int pos)
+  /*
+  ** WRITER
+  */
+
+  Writer::Writer(const std::string &file, char sep, std::size_t blockSize)
+    : _file(file), _temp(file + ".tmp"), _sep(sep),
+      _blockSize(blockSize > 0 ? blockSize : 1), _size(0), _committed(false)
   {
-    if (pos < _content.size())
-    {
-      delete *(_content.begin() + pos);
-      _content.erase(_content.begin() + pos);
-      return true;
-    }
-    return false;
+      _stream.open(_temp.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+      if (!_stream.is_open())
+          throw Error(std::string("Failed to open ").append(_temp));
+      _block.reserve(_blockSize);
   }
 
-  bool Parser::addRow(unsigned int pos, const std::vector<std::string> &r)
+  /*
+  ** Keeps the first `offset` bytes of the file as they are: copies them
+  ** to the temporary file, or in place writes over the file from there.
+  */
+  Writer::Writer(const std::string &file, char sep, std::size_t blockSize, std::uint64_t offset,
+                 bool inPlace)
+    : _file(file), _temp(inPlace ? std::string() : file + ".tmp"), _sep(sep),
+      _blockSize(blockSize > 0 ? blockSize : 1), _size(offset), _committed(false)
   {
-    Row *row = new Row(_header);
+      _block.reserve(_blockSize);
+      if (inPlace)
+      {
+          _stream.open(_file.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+          if (!_stream.is_open())
+              throw Error(std::string("Failed to open ").append(_file));
+          _stream.seekp(static_cast<std::streamoff>(offset));
+          return;
+      }
 
-    for (auto it = r.begin(); it != r.end(); it++)
-      row->push(*it);
-    
-    if (pos <= _content.size())
-    {
-      _content.insert(_content.begin() + pos, row);
-      return true;
-    }
-    return false;
+      std::ifstream in(_file.c_str(), std::ios::in | std::ios::binary);
+      if (!in.is_open())
+          throw Error(std::string("Failed to open ").append(_file));
+      _stream.open(_temp.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+      if (!_stream.is_open())
+          throw Error(std::string("Failed to open ").append(_temp));
+      _block.resize(_blockSize);
+      for (std::uint64_t left = offset; left != 0; )
+      {
+          std::size_t size = static_cast<std::size_t>(std::min<std::uint64_t>(left, _block.size()));
+          if (!in.read(&_block[0], size))
+              throw Error(std::string("Failed to read ").append(_file));
+          _stream.write(_block.data(), size);
+          left -= size;
+      }
+      _block.clear();
   }
 
-  void Parser::sync(void) const
+  Writer::~Writer(void)
   {
-    if (_type == DataType::eFILE)
-    {
-      std::ofstream f;
-      f.open(_file, std::ios::out | std::ios::trunc);
+      if (_committed || _temp.empty())
+          return;
+      std::error_code error;
+      _stream.close();
+      std::filesystem::remove(_temp, error);
+  }
 
-      // header
-      unsigned int i = 0;
-      for (auto it = _header.begin(); it != _header.end(); it++)
+  void Writer::write(const Row &row)
+  {
+      for (unsigned int i = 0; i != row.size(); i++)
       {
-        f << *it;
-        if (i < _header.size() - 1)
-          f << ",";
-        else
-          f << std::endl;
-        i++;
+          if (i != 0)
+              put(std::string_view(&_sep, 1));
+          put(row.value(i));
       }
-     
-      for (auto it = _content.begin(); it != _content.end(); it++)
-        f << **it << std::endl;
-      f.close();
-    }
+      endRecord();
   }
 
-  const std::string &Parser::getFileName(void) const
+  void Writer::write(const std::vector<std::string> &values)
   {
-      return _file;    
+      for (unsigned int i = 0; i != values.size(); i++)
+      {
+          if (i != 0)
+              put(std::string_view(&_sep, 1));
+          put(values[i]);
+      }
+      endRecord();
   }
-  
+
   /*
-  ** ROW
+  ** Size the file will have once what was written so far is flushed.
   */
+  std::uint64_t Writer::size(void) const
+  {
+      return _size;
+  }
 
-  Row::Row(const std::vector<std::string> &header)
-      : _header(header) {}
+  /*
+  ** Flushes the last block and puts the file in place: renames the
+  ** temporary file over it, or cuts it after the rewritten part.
+  */
+  void Writer::commit(void)
+  {
+      if (_committed)
+          return;
+      flush();
+      _stream.close();
+      if (!_stream)
+          throw Error(std::string("Failed to write ").append(_file));
 
-  Row::~Row(void) {}
+      std::error_code error;
+      if (_temp.empty())
+          std::filesystem::resize_file(_file, _size, error);
+      else
+          std::filesystem::rename(_temp, _file, error);
+      if (error)
+          throw Error(std::string("Failed to write ").append(_file));
+      _committed = true;
+  }
 
-  unsigned int Row::size(void) const
+  void Writer::put(std::string_view value)
   {
-    return _values.size();
+      if (_block.size() + value.size() > _blockSize)
+      {
+          flush();
+          // too big for a block, goes straight to the file
+          if (value.size() > _blockSize)
+          {
+              _stream.write(value.data(), value.size());
+              _size += value.size();
+              return;
+          }
+      }
+      _block.append(value.data(), value.size());
+      _size += value.size();
   }
 
-  void Row::push(const std::string &value)
+  void Writer::endRecord(void)
   {
-    _values.push_back(value);
+      put(std::string_view("\n", 1));
   }
 
-  bool Row::set(const std::string &key, const std::string &value) 
+  void Writer::flush(void)
   {
-    std::vector<std::string>::const_iterator it;
-    int pos = 0;
+      _stream.write(_block.data(), _block.size());
+      _block.clear();
+  }
+
+  /*
+  ** SOURCE
+  */
+
+  namespace {
+
+    enum Compression {
+        eNONE,
+        eGZIP,
+        eZSTD
+    };
 
-    for (it = _header.begin(); it != _header.end(); it++)
+    /*
+    ** Compression of a file, told from its first bytes.
+    */
+    Compression compressionOf(const std::string &path)
     {
-        if (key == *it)
+        unsigned char magic[4] = { 0, 0, 0, 0 };
+        std::ifstream in(path.c_str(), std::ios::in | std::ios::binary);
+
+        in.read(reinterpret_cast<char *>(magic), sizeof(magic));
+        if (in.gcount() >= 2 && magic[0] == 0x1F && magic[1] == 0x8B)
+            return eGZIP;
+        if (in.gcount() == 4 && magic[0] == 0x28 && magic[1] == 0xB5 && magic[2] == 0x2F
+            && magic[3] == 0xFD)
+            return eZSTD;
+        return eNONE;
+    }
+
+    class FileSource : public Source
+    {
+      public:
+        FileSource(const std::string &path)
+          : _stream(path.c_str(), std::ios::in | std::ios::binary)
         {
-          _values[pos] = value;
-          return true;
+            if (!_stream.is_open())
+                throw Error(std::string("Failed to open ").append(path));
         }
-        pos++;
-    }
-    return false;
+
+        std::size_t read(char *buffer, std::size_t size)
+        {
+            _stream.read(buffer, size);
+            return static_cast<std::size_t>(_stream.gcount());
+        }
+
+      private:
+        std::ifstream _stream;
+    };
+
+#ifdef CSV_WITH_ZLIB
+    /*
+    ** gzip file, one or more members back to back.
+    */
+    class GzipSource : public Source
+    {
+      public:
+        GzipSource(const std::string &path)
+          : _path(path), _stream(path.c_str(), std::ios::in | std::ios::binary),
+            _input(1 << 16), _ended(false)
+        {
+            if (!_stream.is_open())
+                throw Error(std::string("Failed to open ").append(path));
+            _zstream = z_stream();
+            // 32 lets zlib read the gzip header
+            if (inflateInit2(&_zstream, 15 + 32) != Z_OK)
+                throw Error(std::string("Failed to decompress ").append(path));
+        }
+
+        ~GzipSource(void)
+        {
+            inflateEnd(&_zstream);
+        }
+
+        std::size_t read(char *buffer, std::size_t size)
+        {
+            _zstream.next_out = reinterpret_cast<Bytef *>(buffer);
+            _zstream.avail_out = static_cast<uInt>(size);
+            while (_zstream.avail_out != 0 && !_ended)
+            {
+                if (_zstream.avail_in == 0)
+                {
+                    _stream.read(_input.data(), _input.size());
+                    _zstream.next_in = reinterpret_cast<Bytef *>(_input.data());
+                    _zstream.avail_in = static_cast<uInt>(_stream.gcount());
+                }
+                int status = inflate(&_zstream, Z_NO_FLUSH);
+                if (status == Z_STREAM_END)
+                {
+                    // another member may follow
+                    if (_zstream.avail_in == 0 && _stream.peek() == EOF)
+                        _ended = true;
+                    else
+                        inflateReset(&_zstream);
+                }
+                else if (status != Z_OK && !(status == Z_BUF_ERROR && _zstream.avail_in == 0
+                                             && _stream.peek() != EOF))
+                    throw Error(std::string("corrupted compressed data in ").append(_path));
+            }
+            return size - _zstream.avail_out;
+        }
+
+      private:
+        std::string _path;
+        std::ifstream _stream;
+        std::vector<char> _input;
+        z_stream _zstream;
+        bool _ended;
+    };
+#endif
+
+#ifdef CSV_WITH_ZSTD
+    /*
+    ** zstd file, one or more frames back to back.
+    */
+    class ZstdSource : public Source
+    {
+      public:
+        ZstdSource(const std::string &path)
+          : _path(path), _stream(path.c_str(), std::ios::in | std::ios::binary),
+            _input(ZSTD_DStreamInSize()), _context(ZSTD_createDStream()), _pending(0),
+            _drained(false)
+        {
+            if (!_stream.is_open() || _context == nullptr)
+            {
+                ZSTD_freeDStream(_context);
+                throw Error(std::string("Failed to open ").append(path));
+            }
+            _in.src = _input.data();
+            _in.size = 0;
+            _in.pos = 0;
+        }
+
+        ~ZstdSource(void)
+        {
+            ZSTD_freeDStream(_context);
+        }
+
+        std::size_t read(char *buffer, std::size_t size)
+        {
+            ZSTD_outBuffer out = { buffer, size, 0 };
+
+            while (out.pos != out.size)
+            {
+                if (_in.pos == _in.size && !_drained)
+                {
+                    _stream.read(_input.data(), _input.size());
+                    _in.size = static_cast<std::size_t>(_stream.gcount());
+                    _in.pos = 0;
+                    _drained = (_in.size == 0);
+                }
+
+                std::size_t before = out.pos;
+                std::size_t hint = ZSTD_decompressStream(_context, &out, &_in);
+                if (ZSTD_isError(hint))
+                    throw Error(std::string("corrupted compressed data in ").append(_path));
+                if (_drained && out.pos == before)
+                {
+                    // input over in the middle of a frame
+                    if (_pending != 0)
+                        throw Error(std::string("corrupted compressed data in ").append(_path));
+                    break;
+                }
+                // 0 once a frame is complete
+                _pending = hint;
+            }
+            return out.pos;
+        }
+
+      private:
+        std::string _path;
+        std::ifstream _stream;
+        std::vector<char> _input;
+        ZSTD_DStream *_context;
+        ZSTD_inBuffer _in;
+        std::size_t _pending;
+        bool _drained;
+    };
+#endif
   }
 
-  const std::string Row::operator[](unsigned int valuePosition) const
+  /*
+  ** Opens a file for reading, decompressing it if needed; throws if it
+  ** can't be opened or is compressed with a library not built in.
+  */
+  std::unique_ptr<Source> Source::open(const std::string &path)
   {
-       if (valuePosition < _values.size())
-           return _values[valuePosition];
-       throw Error("can't return this value (doesn't exist)");
+      switch (compressionOf(path))
+      {
+        case eGZIP:
+#ifdef CSV_WITH_ZLIB
+          return std::unique_ptr<Source>(new GzipSource(path));
+#else
+          throw Error(path + " is gzip compressed (build with CSV_WITH_ZLIB to read it)");
+#endif
+        case eZSTD:
+#ifdef CSV_WITH_ZSTD
+          return std::unique_ptr<Source>(new ZstdSource(path));
+#else
+          throw Error(path + " is zstd compressed (build with CSV_WITH_ZSTD to read it)");
+#endif
+        default:
+          return std::unique_ptr<Source>(new FileSource(path));
+      }
   }
 
-  const std::string Row::operator[](const std::string &key) const
+  bool Source::isCompressed(const std::string &path)
+  {
+      return compressionOf(path) != eNONE;
+  }
+
+  /*
+  ** MAPPEDFILE
+  */
+
+  MappedFile::MappedFile(void)
+    : _data(nullptr), _size(0), _open(false)
+#ifdef _WIN32
+    , _fileHandle(INVALID_HANDLE_VALUE), _mapHandle(nullptr)
+#endif
+  {
+  }
+
+  MappedFile::~MappedFile(void)
   {
-      std::vector<std::string>::const_iterator it;
-      int pos = 0;
+      close();
+  }
+
+  bool MappedFile::open(const std::string &path)
+  {
+      close();
+#ifdef _WIN32
+      // writers may keep appending to the file while it is mapped
+      HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+      if (file == INVALID_HANDLE_VALUE)
+          return false;
 
-      for (it = _header.begin(); it != _header.end(); it++)
+      LARGE_INTEGER size;
+      if (!GetFileSizeEx(file, &size))
       {
-          if (key == *it)
-              return _values[pos];
-          pos++;
+          CloseHandle(file);
+          return false;
       }
-      
-      throw Error("can't return this value (doesn't exist)");
+      _fileHandle = file;
+      _size = static_cast<std::size_t>(size.QuadPart);
+      if (_size != 0)
+      {
+          _mapHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+          void *view = (_mapHandle != nullptr)
+              ? MapViewOfFile(_mapHandle, FILE_MAP_READ, 0, 0, 0) : nullptr;
+          if (view == nullptr)
+          {
+              close();
+              return false;
+          }
+          _data = static_cast<const char *>(view);
+      }
+#else
+      int fd = ::open(path.c_str(), O_RDONLY);
+      if (fd < 0)
+          return false;
+
+      struct stat st;
+      if (fstat(fd, &st) != 0)
+      {
+          ::close(fd);
+          return false;
+      }
+      _size = static_cast<std::size_t>(st.st_size);
+      if (_size != 0)
+      {
+          void *view = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+          if (view == MAP_FAILED)
+          {
+              ::close(fd);
+              _size = 0;
+              return false;
+          }
+          madvise(view, _size, MADV_SEQUENTIAL);
+          _data = static_cast<const char *>(view);
+      }
+      // the mapping keeps its own reference to the file
+      ::close(fd);
+#endif
+      _open = true;
+      return true;
   }
 
-  std::ostream &operator<<(std::ostream &os, const Row &row)
+  void MappedFile::close(void)
   {
-      for (unsigned int i = 0; i != row._values.size(); i++)
-          os << row._values[i] << " | ";
+#ifdef _WIN32
+      if (_data != nullptr)
+          UnmapViewOfFile(_data);
+      if (_mapHandle != nullptr)
+          CloseHandle(_mapHandle);
+      if (_fileHandle != INVALID_HANDLE_VALUE)
+          CloseHandle(_fileHandle);
+      _mapHandle = nullptr;
+      _fileHandle = INVALID_HANDLE_VALUE;
+#else
+      if (_data != nullptr)
+          munmap(const_cast<char *>(_data), _size);
+#endif
+      _data = nullptr;
+      _size = 0;
+      _open = false;
+  }
 
-      return os;
+  bool MappedFile::isOpen(void) const
+  {
+      return _open;
   }
 
-  std::ofstream &operator<<(std::ofstream &os, const Row &row)
+  const char *MappedFile::data(void) const
   {
-    for (unsigned int i = 0; i != row._values.size(); i++)
-    {
-        os << row._values[i];
-        if (i < row._values.size() - 1)
-          os << ",";
-    }
-    return os;
+      return _data;
+  }
+
+  std::size_t MappedFile::size(void) const
+  {
+      return _size;
   }
 }
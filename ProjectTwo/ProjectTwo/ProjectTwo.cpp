@@ -362,36 +362,50 @@ void displayCourse(Course course) {
 void loadCourses(string csvPath, BinarySearchTree* bst) {
     cout << "Loading CSV file " << csvPath << endl;
 
-    // initialize the CSV Parser using the given path
-    csv::Parser file = csv::Parser(csvPath);
-
-    // read and display header row - optional
-    vector<string> header = file.getHeader();
-    for (auto const& c : header) {
-        cout << c << " | ";
-    }
-    cout << "" << endl;
+    // course fields by column name, looked up once the header is read
+    auto binding = csv::bind<Course>(
+        csv::member("CourseNumber", &Course::courseNumber),
+        csv::member("Name", &Course::courseName),
+        csv::member("Prerequisite1", &Course::prereqOne),
+        csv::member("Prerequisite2", &Course::prereqTwo));
+
+    // hand each course straight to the tree as its record is read,
+    // without building a table of the whole file first
+    csv::Options options;
+    options.lenient = true;
+    csv::Stats stats;
+    vector<csv::BadRecord> skipped;
+    size_t count = 0;
 
     try {
-        // loop to read rows of a CSV file
-        for (unsigned int i = 0; i < file.rowCount(); i++) {
-
-            // Create a data structure and add to the collection of bids
-            Course course;
-            course.courseNumber = file[i][0];
-            course.courseName = file[i][1];
-            course.prereqOne = file[i][2];
-            course.prereqTwo = file[i][3];
-
-            //cout << "Item: " << bid.title << ", Fund: " << bid.fund << ", Amount: " << bid.amount << endl;
+        csv::parse(csvPath, [&](csv::RecordView record) {
+            if (count++ == 0) {
+                // read and display header row - optional
+                for (auto const& c : record.header().names()) {
+                    cout << c << " | ";
+                }
+                cout << "" << endl;
+
+                binding.resolve(record.header());
+            }
 
-            // push this bid to the end
-            bst->Insert(course);
-        }
+            // Create a data structure and add it to the tree
+            bst->Insert(binding.decode(record));
+        }, ',', options, &stats, &skipped);
     } catch (csv::Error &e) {
         std::cerr << e.what() << std::endl;
     }
-    cout << file.rowCount() << " courses loaded." << endl; // number of courses loaded
+
+    // report where the load time went
+    cout << "time: read " << stats.readNs / 1000000.0 << " ms, tokenize "
+         << stats.tokenizeNs / 1000000.0 << " ms, build " << stats.buildNs / 1000000.0
+         << " ms" << endl;
+
+    // report the malformed records left out instead of losing the file
+    for (auto const& bad : skipped) {
+        cerr << "line " << bad.line << " skipped: " << bad.reason << endl;
+    }
+    cout << count << " courses loaded." << endl; // number of courses loaded
 }
 
 /**
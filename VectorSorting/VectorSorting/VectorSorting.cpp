@@ -18,9 +18,6 @@ using namespace std;
 // Global definitions visible to all methods and classes
 //============================================================================
 
-// forward declarations
-double strToDouble(string str, char ch);
-
 // define a structure to hold bid information
 struct Bid {
     string bidId; // unique identifier
@@ -69,7 +66,9 @@ Bid getBid() {
     cin.ignore();
     string strAmount;
     getline(cin, strAmount);
-    bid.amount = strToDouble(strAmount, '$');
+    csv::Cents amount;
+    csv::parseCurrency(strAmount, amount);
+    bid.amount = amount.toDouble();
 
     return bid;
 }
@@ -77,33 +76,67 @@ Bid getBid() {
 /**
  * Load a CSV file containing bids into a container
  *
- * @param csvPath the path to the CSV file to load
+ * @param csvPath the path to the CSV file to load, or a pattern
+ *        matching several files
  * @return a container holding all the bids read
  */
 vector<Bid> loadBids(string csvPath) {
-    cout << "Loading CSV file " << csvPath << endl;
-
     // Define a vector data structure to hold a collection of bids.
     vector<Bid> bids;
 
-    // initialize the CSV Parser using the given path
-    csv::Parser file = csv::Parser(csvPath);
-
     try {
-        // loop to read rows of a CSV file
-        for (int i = 0; i < file.rowCount(); i++) {
+        // a pattern such as "eBid_Monthly_Sales_*.csv" loads every monthly
+        // file it matches, in name order
+        vector<string> csvPaths = csv::glob(csvPath);
+        for (auto const& path : csvPaths) {
+            cout << "Loading CSV file " << path << endl;
+        }
+
+        // bid fields by column name, as the monthly exports have named
+        // them, looked up once the header is read
+        auto binding = csv::bind<Bid>(
+            csv::member({ "Auction ID", "ArticleID" }, &Bid::bidId),
+            csv::member({ "Auction Title", "ArticleTitle" }, &Bid::title),
+            csv::member("Fund", &Bid::fund),
+            csv::member({ "Winning Bid", "WinningBid" }, &Bid::amount));
+
+        // initialize the CSV Parser using the given path, keeping only
+        // the columns bound above
+        csv::Options options;
+        options.columnAliases = binding.names();
+        options.stats = true;
+        options.lenient = true;
+
+        // parse the files side by side, keeping their order for the bids
+        vector<unique_ptr<csv::Parser>> files = csv::parseFiles(csvPaths, csv::eMAPPED, ',', options);
+
+        for (auto const& parsed : files) {
+            csv::Parser& file = *parsed;
+
+            // report where the load time went
+            csv::Stats stats = file.stats();
+            cout << "time: read " << stats.readNs / 1000000.0 << " ms, tokenize "
+                 << stats.tokenizeNs / 1000000.0 << " ms, build " << stats.buildNs / 1000000.0
+                 << " ms" << endl;
+
+            // report the malformed records left out instead of losing the file
+            for (auto const& bad : file.badRecords()) {
+                cerr << "line " << bad.line << " skipped: " << bad.reason << endl;
+            }
+
+            binding.resolve(file.header());
+
+            // loop to read rows of a CSV file
+            for (int i = 0; i < file.rowCount(); i++) {
 
-            // Create a data structure and add to the collection of bids
-            Bid bid;
-            bid.bidId = file[i][1];
-            bid.title = file[i][0];
-            bid.fund = file[i][8];
-            bid.amount = strToDouble(file[i][4], '$');
+                // Create a data structure and add to the collection of bids
+                Bid bid = binding.decode(file[i]);
 
-            //cout << "Item: " << bid.title << ", Fund: " << bid.fund << ", Amount: " << bid.amount << endl;
+                //cout << "Item: " << bid.title << ", Fund: " << bid.fund << ", Amount: " << bid.amount << endl;
 
-            // push this bid to the end
-            bids.push_back(bid);
+                // push this bid to the end
+                bids.push_back(bid);
+            }
         }
     } catch (csv::Error &e) {
         std::cerr << e.what() << std::endl;
@@ -220,19 +253,6 @@ for (size_t pos = 0; pos < size - 1; ++pos) {
 }
 
 
-/**
- * Simple C function to convert a string to a double
- * after stripping out unwanted char
- *
- * credit: http://stackoverflow.com/a/24875936
- *
- * @param ch The character to strip out
- */
-double strToDouble(string str, char ch) {
-    str.erase(remove(str.begin(), str.end(), ch), str.end());
-    return atof(str.c_str());
-}
-
 /**
  * The one and only main() method
  */